@@ -113,6 +113,12 @@ double AttributeList::getAttributeByIndex(int index)
 }
 
 
+const char *AttributeList::getAttributeName(int index)
+{
+    return (index < attrCount) ? names[index] : NULL;
+}
+
+
 void AttributeList::dump()
 {
     if (attrCount == 0) return;
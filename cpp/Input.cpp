@@ -9,11 +9,19 @@
 #include "Input.h"
 #include "Key.h"
 #include "Options.h"
+#include "Parallel.h"
+#include "ValueIndex.h"
 #include "VariableList.h"
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <queue>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 
 struct LostVar {
         int num;
@@ -45,9 +53,243 @@ bool KeepVal(LostVar *lostvarpt, char * var) {
     return false;
 }
 
+/*
+ * Bounded-memory aggregation. With the "read-memory" option, the table summing the data
+ * is limited to as many tuples as fit in the budget (allowing for the table's growth and
+ * its accumulation hash). When it fills, its tuples are sorted and appended to a temporary
+ * file as a run, and the table starts again, empty. At the end of the data the runs are
+ * merged, summing the tuples with the same key, into a table sized for just the distinct
+ * keys. So memory is needed for the distinct keys of the whole data once, however many
+ * raw lines there are.
+ *
+ * All the runs share one file, so the number of open files doesn't grow with the data.
+ * A merge reads at most MERGE_FAN_IN runs at once, each through a small buffer; when
+ * there are more runs than that, groups of them are first merged into longer runs in a
+ * second file, and so on, until one merge can take them all.
+ */
+static const int MERGE_FAN_IN = 64;
+static const long long MERGE_BUFFER_SIZE = 64 << 10;
+
+class DataRuns {
+    public:
+        DataRuns(int keysize, double megabytes) :
+                keysize(keysize), maxTuples(0), current(0) {
+            tupleBytes = keysize * sizeof(KeySegment) + sizeof(double);
+            if (megabytes > 0)
+                maxTuples = (long long) (megabytes * (1 << 20)) / (2 * tupleBytes + 4 * sizeof(long long));
+            if (megabytes > 0 && maxTuples < 1024)
+                maxTuples = 1024;
+            files[0] = files[1] = NULL;
+        }
+        ~DataRuns() {
+            for (int f = 0; f < 2; f++) {
+                if (files[f])
+                    fclose(files[f]);
+            }
+        }
+
+        //-- if the table has reached the limit, write it out as a run and empty it
+        void check(Table *table) {
+            if (maxTuples > 0 && table->getTupleCount() >= maxTuples) {
+                writeRun(table);
+                table->reset(keysize);
+                table->beginHashAccumulation(maxTuples);
+            }
+        }
+
+        //-- how many tuples (and new values) each of a round of mapped-data chunks may
+        //-- hold, so that together they take about the table's share; 0 for no limit
+        long long getChunkLimit(int chunks) {
+            if (maxTuples == 0)
+                return 0;
+            long long limit = maxTuples / (chunks > 0 ? chunks : 1);
+            return limit < 1024 ? 1024 : limit;
+        }
+
+        //-- end accumulation, returning the sorted table: the table itself if it never
+        //-- filled, or else a new table merged from the runs (and the old one deleted)
+        Table *finish(Table *table) {
+            table->finalize();
+            if (runs.empty())
+                return table;
+            writeRun(table);
+            delete table;
+            while (runs.size() > (size_t) MERGE_FAN_IN)
+                mergePass();
+            //-- merge once to count the distinct keys, and again to fill the table
+            long long count = mergeRuns(0, runs.size(), NULL, NULL);
+            Table *merged = new Table(keysize, count > 0 ? count : 1);
+            mergeRuns(0, runs.size(), merged, NULL);
+            return merged;
+        }
+
+    private:
+        //-- a run's place in the current file
+        struct Run {
+                long long offset;
+                long long count; // tuples in the run
+        };
+
+        //-- a run being merged, read through a buffer of whole tuples
+        struct RunReader {
+                long long offset; // of the next unbuffered tuple
+                long long remaining; // tuples not yet buffered
+                std::vector<char> buffer;
+                size_t position, length;
+                KeySegment *key; // the current tuple, in the buffer
+                double value;
+        };
+
+        //-- orders runs in a merge by their current keys, least first
+        struct LaterRun {
+                LaterRun(std::vector<RunReader> &readers, int keysize) :
+                        readers(&readers), keysize(keysize) {
+                }
+                bool operator()(int a, int b) const {
+                    int compare = Key::compareKeys((*readers)[a].key, (*readers)[b].key, keysize);
+                    return compare != 0 ? compare > 0 : a > b;
+                }
+                std::vector<RunReader> *readers;
+                int keysize;
+        };
+
+        static FILE *makeTemporary() {
+            FILE *fd = tmpfile();
+            if (fd == NULL) {
+                printf("ERROR: unable to create a temporary file for the data\n");
+                exit(1);
+            }
+            return fd;
+        }
+
+        static void checkWrite(FILE *fd) {
+            if (fflush(fd) != 0 || ferror(fd)) {
+                printf("ERROR: unable to write temporary file for the data\n");
+                exit(1);
+            }
+        }
+
+        static void writeTuple(FILE *fd, const KeySegment *key, int keysize, double value) {
+            fwrite(key, sizeof(KeySegment), keysize, fd);
+            fwrite(&value, sizeof(value), 1, fd);
+        }
+
+        void writeRun(Table *table) {
+            table->finalize();
+            if (files[current] == NULL)
+                files[current] = makeTemporary();
+            FILE *fd = files[current];
+            Run run;
+            run.offset = ftello(fd);
+            run.count = table->getTupleCount();
+            for (long long i = 0; i < run.count; i++)
+                writeTuple(fd, table->getKey(i), keysize, table->getValue(i));
+            checkWrite(fd);
+            runs.push_back(run);
+        }
+
+        //-- read the next tuple of a run; false at its end
+        bool advance(RunReader &reader) {
+            if (reader.position == reader.length) {
+                if (reader.remaining == 0)
+                    return false;
+                long long tuples = reader.buffer.size() / tupleBytes;
+                if (tuples > reader.remaining)
+                    tuples = reader.remaining;
+                reader.length = tuples * tupleBytes;
+                if (pread(fileno(files[current]), &reader.buffer[0], reader.length, reader.offset)
+                        != (ssize_t) reader.length) {
+                    printf("ERROR: unable to read temporary file for the data\n");
+                    exit(1);
+                }
+                reader.offset += reader.length;
+                reader.remaining -= tuples;
+                reader.position = 0;
+            }
+            char *tuple = &reader.buffer[reader.position];
+            reader.key = (KeySegment*) tuple;
+            memcpy(&reader.value, tuple + keysize * sizeof(KeySegment), sizeof(reader.value));
+            reader.position += tupleBytes;
+            return true;
+        }
+
+        //-- merge runs [first, last), adding the summed tuples to the table or writing
+        //-- them to the file (if either); return the number of distinct keys
+        long long mergeRuns(size_t first, size_t last, Table *table, FILE *out) {
+            std::vector<RunReader> readers(last - first);
+            long long bufferTuples = MERGE_BUFFER_SIZE / tupleBytes > 0 ? MERGE_BUFFER_SIZE / tupleBytes : 1;
+            std::priority_queue<int, std::vector<int>, LaterRun> queue(LaterRun(readers, keysize));
+            for (size_t r = 0; r < readers.size(); r++) {
+                RunReader &reader = readers[r];
+                reader.offset = runs[first + r].offset;
+                reader.remaining = runs[first + r].count;
+                reader.buffer.resize(bufferTuples * tupleBytes);
+                reader.position = reader.length = 0;
+                reader.key = NULL;
+                reader.value = 0;
+                if (advance(reader))
+                    queue.push(r);
+            }
+            std::vector<KeySegment> key(keysize);
+            long long count = 0;
+            while (!queue.empty()) {
+                int r = queue.top();
+                queue.pop();
+                memcpy(&key[0], readers[r].key, keysize * sizeof(KeySegment));
+                double value = readers[r].value;
+                if (advance(readers[r]))
+                    queue.push(r);
+                while (!queue.empty() && Key::compareKeys(readers[queue.top()].key, &key[0], keysize) == 0) {
+                    r = queue.top();
+                    queue.pop();
+                    value += readers[r].value;
+                    if (advance(readers[r]))
+                        queue.push(r);
+                }
+                if (table)
+                    table->addTuple(&key[0], value);
+                if (out)
+                    writeTuple(out, &key[0], keysize, value);
+                count++;
+            }
+            return count;
+        }
+
+        //-- merge each group of MERGE_FAN_IN runs into one run in the other file, and
+        //-- empty this one
+        void mergePass() {
+            int other = 1 - current;
+            if (files[other] == NULL)
+                files[other] = makeTemporary();
+            FILE *out = files[other];
+            std::vector<Run> merged;
+            for (size_t first = 0; first < runs.size(); first += MERGE_FAN_IN) {
+                size_t last = first + MERGE_FAN_IN < runs.size() ? first + MERGE_FAN_IN : runs.size();
+                Run run;
+                run.offset = ftello(out);
+                run.count = mergeRuns(first, last, NULL, out);
+                merged.push_back(run);
+            }
+            checkWrite(out);
+            if (ftruncate(fileno(files[current]), 0) != 0 || fseeko(files[current], 0, SEEK_SET) != 0) {
+                printf("ERROR: unable to write temporary file for the data\n");
+                exit(1);
+            }
+            runs.swap(merged);
+            current = other;
+        }
+
+        int keysize;
+        long long tupleBytes; // bytes of a tuple in a run
+        long long maxTuples; // tuples in a run, or 0 for no limit
+        FILE *files[2]; // the file holding the runs, and the one a merge pass writes to
+        int current;
+        std::vector<Run> runs;
+};
+
 /*ReadData - read data tuples, one per line; return number of lines read
  */
-long ocReadData(FILE *fin, VariableList *vars, Table *indata, LostVar *lostvarp) {
+long ocReadData(FILE *fin, VariableList *vars, Table *indata, LostVar *lostvarp, DataRuns *runs) {
     char line[MAXLINE];
     KeySegment *key = 0;
     int lineno = 0;
@@ -157,6 +399,7 @@ long ocReadData(FILE *fin, VariableList *vars, Table *indata, LostVar *lostvarp)
         if (flag == KEEP) {
             Key::buildKey(key, keysize, vars, indices, values, varCount);
             indata->sumTuple(key, tupleValue);
+            runs->check(indata);
         }
         flag = KEEP;
 
@@ -175,6 +418,390 @@ long ocReadData(FILE *fin, VariableList *vars, Table *indata, LostVar *lostvarp)
     return l;
 }
 
+/*
+ * Mapped data reading. When the data file is a regular file, the rest of it (after the
+ * options) is memory-mapped and the data lines are parsed in chunks, in parallel. Each
+ * chunk numbers the values of each variable in the order it first sees them, and sums
+ * its tuples (keyed by these chunk-local numbers) in its own table. The chunks are then
+ * merged in file order: each value first seen in a chunk is looked up in the variable's
+ * value map, just as ocReadData does, so the value numbering (and any cardinality error)
+ * is the same as for a sequential read. Chunks are a fixed size, so the results don't
+ * depend on the number of threads.
+ *
+ * With the "read-memory" option, each chunk of a round may hold only its share of the
+ * budget's tuples (counting its new values too). A chunk which reaches that stops early,
+ * and the rest of it is read, in turn, after it is merged.
+ */
+static const long long READ_CHUNK_SIZE = 4 << 20;
+
+//-- something a chunk needs done, in order, when it is merged: a value seen for the
+//-- first time in the chunk, or an error which ends the read
+struct DataEvent {
+        enum Kind { NewValue, PrematureEnd, BadLostVar, LongLine } kind;
+        int var; // index of the variable in use
+        int column; // index of the column on the line
+        long long lineno; // line number within the chunk
+        std::string value;
+        const char *line; // start of the line, in the mapped data
+};
+
+struct DataChunk {
+        const char *start, *end;
+        long long lines; // count of lines, for line numbers
+        long long dataLines; // count of data lines read
+        long long limit; // tuples and new values to hold before stopping, or 0 for no limit
+        const char *stop; // where reading stopped: end, unless the limit was reached
+        Table *table;
+        std::vector<DataEvent> events;
+        bool failed;
+};
+
+class MappedFile {
+    public:
+        MappedFile() :
+                base(NULL), size(0), start(NULL), end(NULL) {
+        }
+        ~MappedFile() {
+            if (base)
+                munmap(base, size);
+        }
+        //-- map the rest of a regular file, from its current position
+        bool open(FILE *fd) {
+            struct stat info;
+            long offset = ftell(fd);
+            if (offset < 0 || fstat(fileno(fd), &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= offset)
+                return false;
+            size = info.st_size;
+            base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fd), 0);
+            if (base == MAP_FAILED) {
+                base = NULL;
+                return false;
+            }
+            madvise(base, size, MADV_SEQUENTIAL);
+            start = (const char*) base + offset;
+            end = (const char*) base + size;
+            return true;
+        }
+        void *base;
+        size_t size;
+        const char *start, *end;
+};
+
+static inline bool isLineEnd(char c) {
+    return c == '\r' || c == '\n';
+}
+
+//-- find the first directive line (one starting with ':') in the data. Returns the
+//-- start of that line, or end if there is none.
+static const char *findDirective(const char *start, const char *end) {
+    const char *cp = start;
+    while ((cp = (const char*) memchr(cp, ':', end - cp)) != NULL) {
+        const char *lineStart = cp;
+        while (lineStart > start && !isLineEnd(lineStart[-1]) && isspace(lineStart[-1]))
+            lineStart--;
+        if (lineStart == start || isLineEnd(lineStart[-1]))
+            return lineStart;
+        cp++;
+    }
+    return end;
+}
+
+//-- copy one line into a buffer as Options::getLine does: a comment is dropped, and
+//-- the line is trimmed. Returns the start of the next line.
+static const char *copyLine(const char *cp, const char *end, char *line, size_t &length) {
+    const char *lineEnd = cp;
+    while (lineEnd < end && !isLineEnd(*lineEnd))
+        lineEnd++;
+    const char *contentEnd = (const char*) memchr(cp, '#', lineEnd - cp);
+    if (contentEnd == NULL)
+        contentEnd = lineEnd;
+    while (cp < contentEnd && isspace(*cp))
+        cp++;
+    while (contentEnd > cp && isspace(contentEnd[-1]))
+        contentEnd--;
+    length = contentEnd - cp;
+    if (length < MAXLINE) {
+        memcpy(line, cp, length);
+        line[length] = '\0';
+    }
+    return lineEnd < end ? lineEnd + 1 : end;
+}
+
+static void readChunk(DataChunk &chunk, VariableList *vars, LostVar *lostvarp) {
+    int keysize = vars->getKeySize();
+    int varCountDF = vars->getVarCountDF();
+    int varCount = vars->getVarCount();
+    KeySegment *key = new KeySegment[keysize];
+    int *values = new int[varCount];
+    int *indices = new int[varCount];
+    char *line = new char[MAXLINE];
+    char *var = new char[MAXLINE];
+    char *newvalue = new char[MAXLINE];
+    std::vector<ValueIndex> valueIds(varCount);
+    std::vector<int> valueCounts(varCount, 0);
+    LostVar *lostvarpt;
+
+    const char *lineStart = chunk.start;
+    auto fail = [&](DataEvent::Kind kind, int j, int i) {
+        DataEvent event;
+        event.kind = kind;
+        event.var = j;
+        event.column = i;
+        event.lineno = chunk.lines;
+        event.line = lineStart;
+        chunk.events.push_back(event);
+        chunk.failed = true;
+    };
+    //-- the chunk's number for a value, which is new if the value is new. Returns -1 if
+    //-- there are more values than the cardinality allows.
+    auto localValue = [&](int j, int i, const char *cp) {
+        int chr;
+        for (chr = 0; chr < 99; chr++) {
+            if (cp[chr] == '\0' || isspace(cp[chr]) || (cp[chr] == ','))
+                break;
+        }
+        int found = valueIds[j].find(cp, chr);
+        if (found >= 0)
+            return found;
+        int value = valueCounts[j]++;
+        valueIds[j].add(cp, chr, value);
+        DataEvent event;
+        event.kind = DataEvent::NewValue;
+        event.var = j;
+        event.column = i;
+        event.lineno = chunk.lines;
+        event.value.assign(cp, chr);
+        event.line = lineStart;
+        chunk.events.push_back(event);
+        if (value >= vars->getVariable(j)->cardinality) {
+            chunk.failed = true;
+            return -1;
+        }
+        return value;
+    };
+
+    const char *cp0 = chunk.start;
+    while (cp0 < chunk.end && !chunk.failed) {
+        if (chunk.limit > 0 && chunk.table->getTupleCount() + (long long) chunk.events.size() >= chunk.limit)
+            break;
+        //-- a line starting with a comment doesn't count in the line numbers
+        bool counted = *cp0 != '#';
+        size_t length;
+        lineStart = cp0;
+        cp0 = copyLine(cp0, chunk.end, line, length);
+        if (counted)
+            chunk.lines++;
+        if (length >= MAXLINE) {
+            line[0] = '\0';
+            fail(DataEvent::LongLine, 0, 0);
+            break;
+        }
+        if (length == 0)
+            continue;
+        chunk.dataLines++;
+        char *cp = line;
+        bool keep = true;
+        int j = 0;
+        for (int i = 0; i < varCountDF && !chunk.failed; i++) {
+            if (vars->isVarInUse(i)) {
+                int value = 0;
+                if ((vars->getVariable(j)->rebin == true) || (vars->getVariable(j)->exclude != NULL)) {
+                    newvalue[0] = '\0';
+                    vars->getNewValue(j, cp, newvalue);
+                    if (newvalue[0] != '\0')
+                        value = localValue(j, i, newvalue);
+                    else
+                        keep = false;
+                } else {
+                    if (cp[0] == '\0') {
+                        fail(DataEvent::PrematureEnd, j, i);
+                        break;
+                    }
+                    value = localValue(j, i, cp);
+                }
+                values[j] = value;
+                indices[j] = j;
+                j++;
+            } else if (lostvarp != NULL && isLostVar(i, &lostvarpt, lostvarp)) {
+                if (sscanf(cp, "%[^\t, ]", var) == 1) {
+                    if (!KeepVal(lostvarpt, var))
+                        keep = false;
+                } else {
+                    fail(DataEvent::BadLostVar, j, i);
+                    break;
+                }
+            }
+            while (*cp && !(isspace(*cp) || (*cp == ',')))
+                cp++;
+            while (*cp && (isspace(*cp) || (*cp == ',')))
+                cp++; // now at next value
+        }
+        if (chunk.failed)
+            break;
+        double tupleValue = *cp ? (double) strtod(cp, (char **) NULL) : 1;
+        if (keep) {
+            Key::buildKey(key, keysize, vars, indices, values, varCount);
+            chunk.table->sumTuple(key, tupleValue);
+        }
+    }
+    chunk.stop = cp0;
+    delete[] newvalue;
+    delete[] var;
+    delete[] line;
+    delete[] indices;
+    delete[] values;
+    delete[] key;
+}
+
+//-- merge a chunk into the data table, mapping its value numbers to the variables'.
+//-- Any error in the chunk is reported here, so errors come out in file order.
+static void mergeChunk(DataChunk &chunk, long long lineBase, VariableList *vars, Table *indata, DataRuns *runs) {
+    int keysize = vars->getKeySize();
+    int varCount = vars->getVarCount();
+    std::vector<std::vector<int> > globalIds(varCount);
+    char *line = new char[MAXLINE];
+    for (size_t e = 0; e < chunk.events.size(); e++) {
+        DataEvent &event = chunk.events[e];
+        long long lineno = lineBase + event.lineno;
+        int j = event.var;
+        size_t length;
+        if (event.kind != DataEvent::NewValue)
+            copyLine(event.line, chunk.end, line, length);
+        switch (event.kind) {
+            case DataEvent::NewValue: {
+                int value = vars->getVarValueIndex(j, event.value.c_str());
+                if (value < 0) {
+                    copyLine(event.line, chunk.end, line, length);
+                    printf("Error in data, line %lld: new value exceeds cardinality of variable #%d, \"%s\"\n",
+                            lineno, event.column + 1, vars->getVariable(j)->abbrev);
+                    int cardinality = vars->getVariable(j)->cardinality;
+                    printf("Cardinality should be %d. ", cardinality);
+                    printf("Previously seen values: ");
+                    for (int k = 0; k < cardinality; ++k) {
+                        printf("%s ", vars->getVariable(j)->valmap[k]);
+                    }
+                    printf("\nData line: %s\n", line);
+                    exit(1);
+                }
+                globalIds[j].push_back(value);
+                break;
+            }
+            case DataEvent::PrematureEnd:
+                printf("ERROR: Expected additional input, but line ended prematurely\n");
+                printf("Line number: %lld\n", lineno);
+                printf("Line so far: %s\n", line);
+                exit(1);
+            case DataEvent::BadLostVar:
+                printf("something went wrong");
+                exit(1);
+            case DataEvent::LongLine:
+                printf("Error: maximum line length (%d) exceeded in data file.\n", MAXLINE);
+                printf("Line number: %lld\n", lineno);
+                exit(1);
+        }
+    }
+    KeySegment *key = new KeySegment[keysize];
+    int *values = new int[varCount];
+    int *indices = new int[varCount];
+    for (int j = 0; j < varCount; j++)
+        indices[j] = j;
+    Table *table = chunk.table;
+    for (long long t = 0; t < table->getTupleCount(); t++) {
+        KeySegment *localKey = table->getKey(t);
+        for (int j = 0; j < varCount; j++)
+            values[j] = globalIds[j][Key::getKeyValue(localKey, keysize, vars, j)];
+        Key::buildKey(key, keysize, vars, indices, values, varCount);
+        indata->sumTuple(key, table->getValue(t));
+        runs->check(indata);
+    }
+    delete[] indices;
+    delete[] values;
+    delete[] key;
+    delete[] line;
+}
+
+/*ReadMappedData - read data tuples from memory, up to the next directive line or the
+ * end; return number of lines read. On return, next is the start of the line after the
+ * directive, or NULL if the data ran to the end.
+ */
+static long ocReadMappedData(const char *start, const char *end, const char **next, VariableList *vars,
+        Table *indata, LostVar *lostvarp, DataRuns *runs, int threadOption) {
+    const char *dataEnd = findDirective(start, end);
+    *next = NULL;
+    if (dataEnd < end) {
+        //-- see if there is test data; if so, stop here
+        char *line = new char[MAXLINE];
+        size_t length;
+        *next = copyLine(dataEnd, end, line, length);
+        if (strcmp(line, ":test") != 0)
+            printf("Unrecognized directive here: %s\n", line);
+        delete[] line;
+    }
+
+    //-- split the data into chunks which end at line ends
+    std::vector<DataChunk> chunks;
+    for (const char *cp = start; cp < dataEnd;) {
+        DataChunk chunk;
+        chunk.start = cp;
+        if (dataEnd - cp > READ_CHUNK_SIZE) {
+            cp += READ_CHUNK_SIZE;
+            while (cp < dataEnd && !isLineEnd(cp[-1]))
+                cp++;
+        } else {
+            cp = dataEnd;
+        }
+        chunk.end = cp;
+        chunk.lines = 0;
+        chunk.dataLines = 0;
+        chunk.stop = chunk.start;
+        chunk.table = NULL;
+        chunk.failed = false;
+        chunks.push_back(chunk);
+    }
+
+    //-- read the chunks a round at a time (one per thread), merging each round in order
+    long long chunkCount = chunks.size();
+    int threadCount = ocThreadCount(threadOption, chunkCount);
+    long long limit = runs->getChunkLimit(threadCount);
+    for (long long c = 0; c < chunkCount; c++)
+        chunks[c].limit = limit;
+    long long lineBase = 0;
+    long dataLines = 0;
+    for (long long round = 0; round < chunkCount; round += threadCount) {
+        long long roundEnd = round + threadCount < chunkCount ? round + threadCount : chunkCount;
+        for (long long c = round; c < roundEnd; c++) {
+            chunks[c].table = new Table(vars->getKeySize(), 64);
+            chunks[c].table->beginHashAccumulation();
+        }
+        ocRunThreads(roundEnd - round, [&](int t) {
+            readChunk(chunks[round + t], vars, lostvarp);
+        });
+        for (long long c = round; c < roundEnd; c++) {
+            DataChunk &chunk = chunks[c];
+            while (true) {
+                mergeChunk(chunk, lineBase, vars, indata, runs);
+                lineBase += chunk.lines;
+                dataLines += chunk.dataLines;
+                delete chunk.table;
+                chunk.table = NULL;
+                chunk.events.clear();
+                if (chunk.stop == chunk.end)
+                    break;
+                //-- the chunk reached its limit; read the rest of it
+                chunk.start = chunk.stop;
+                chunk.lines = 0;
+                chunk.dataLines = 0;
+                chunk.table = new Table(vars->getKeySize(), 64);
+                chunk.table->beginHashAccumulation();
+                readChunk(chunk, vars, lostvarp);
+            }
+        }
+    }
+    if (dataLines == 0 && *next == NULL)
+        printf("No data\n");
+    return dataLines;
+}
+
 void ocDefineVariables(Options *options, VariableList *vars) {
     //-- variable def is "name,cardinality,type,abbrev"
     //-- types are 1=iv, 0 or 2=dv. Note that neutral systems may have all variables dv,
@@ -581,6 +1208,7 @@ void ocRebinDefineVar(Options *options, VariableList *vars, LostVar ** lostvarp)
                             break;
                     } //end of while for tokenizing
                     Done: varpt->oldnew[NEW_ROW][index] = NULL; //marks end of mapping
+                    vars->indexRebinning(num_var_actual - 1);
 
                 } //end of variable is kept
                 done1: rebin[0] = '\0';
@@ -607,6 +1235,202 @@ void ocRebinDefineVar(Options *options, VariableList *vars, LostVar ** lostvarp)
     return;
 }
 
+/*
+ * Data cache files. A data cache holds a data file as it is after reading: the options
+ * text ahead of the data, the variables with their value maps, and the aggregated,
+ * sorted input and test tables. Loading one maps the file and copies the tables out,
+ * with no data lines to parse or sum. The layout (native byte order) is:
+ *   magic, version, count of data lines read, options text
+ *   variable count; for each variable: name, abbrev, cardinality, segment, shift, size,
+ *     dv, mask, value count, and each value
+ *   key size; input tuple count, keys and values; test tuple count (-1 if none), keys
+ *     and values
+ * The variables are stored as they were after checkCardinalities, and the tables as
+ * they were read, before any constant is added or they are normalized.
+ */
+static const char dataCacheMagic[8] = { 'O', 'C', 'C', 'A', 'M', 'D', 'A', 'T' };
+static const int dataCacheVersion = 1;
+
+static void writeCacheString(FILE *fd, const char *str, int len) {
+    fwrite(&len, sizeof(len), 1, fd);
+    fwrite(str, 1, len, fd);
+}
+
+static void writeCacheTable(FILE *fd, Table *table) {
+    long long count = table ? table->getTupleCount() : -1;
+    fwrite(&count, sizeof(count), 1, fd);
+    for (long long i = 0; i < count; i++) {
+        fwrite(table->getKey(i), sizeof(KeySegment), table->getKeySize(), fd);
+    }
+    for (long long i = 0; i < count; i++) {
+        double value = table->getValue(i);
+        fwrite(&value, sizeof(value), 1, fd);
+    }
+}
+
+static bool ocWriteDataCache(const char *path, const std::string &header, VariableList *vars, Table *indata,
+        Table *testdata, int dataLines) {
+    std::string tmpPath = std::string(path) + ".tmp";
+    FILE *fd = fopen(tmpPath.c_str(), "wb");
+    if (fd == NULL)
+        return false;
+    fwrite(dataCacheMagic, 1, sizeof(dataCacheMagic), fd);
+    fwrite(&dataCacheVersion, sizeof(dataCacheVersion), 1, fd);
+    fwrite(&dataLines, sizeof(dataLines), 1, fd);
+    writeCacheString(fd, header.data(), header.size());
+    int varCount = vars->getVarCount();
+    fwrite(&varCount, sizeof(varCount), 1, fd);
+    for (int i = 0; i < varCount; i++) {
+        Variable *varp = vars->getVariable(i);
+        writeCacheString(fd, varp->name, strlen(varp->name));
+        writeCacheString(fd, varp->abbrev, strlen(varp->abbrev));
+        fwrite(&varp->cardinality, sizeof(varp->cardinality), 1, fd);
+        fwrite(&varp->segment, sizeof(varp->segment), 1, fd);
+        fwrite(&varp->shift, sizeof(varp->shift), 1, fd);
+        fwrite(&varp->size, sizeof(varp->size), 1, fd);
+        char dv = varp->dv;
+        fwrite(&dv, sizeof(dv), 1, fd);
+        fwrite(&varp->mask, sizeof(varp->mask), 1, fd);
+        fwrite(&varp->valueCount, sizeof(varp->valueCount), 1, fd);
+        for (int j = 0; j < varp->valueCount; j++) {
+            writeCacheString(fd, varp->valmap[j], strlen(varp->valmap[j]));
+        }
+    }
+    int keysize = vars->getKeySize();
+    fwrite(&keysize, sizeof(keysize), 1, fd);
+    writeCacheTable(fd, indata);
+    writeCacheTable(fd, testdata);
+    bool ok = !ferror(fd);
+    if (fclose(fd) != 0)
+        ok = false;
+    if (ok && rename(tmpPath.c_str(), path) != 0)
+        ok = false;
+    if (!ok)
+        remove(tmpPath.c_str());
+    return ok;
+}
+
+//-- bounds-checked reading from a mapped data cache
+class CacheReader {
+    public:
+        CacheReader(const char *start, const char *end) :
+                cp(start), end(end) {
+        }
+        //-- the next n bytes, or NULL if the file ends first
+        const char *take(long long n) {
+            if (n < 0 || end - cp < n)
+                return NULL;
+            const char *block = cp;
+            cp += n;
+            return block;
+        }
+        template<typename T> bool get(T &value) {
+            const char *block = take(sizeof(value));
+            if (block)
+                memcpy(&value, block, sizeof(value));
+            return block != NULL;
+        }
+        bool getString(std::string &str) {
+            int len;
+            const char *block;
+            if (!get(len) || (block = take(len)) == NULL)
+                return false;
+            str.assign(block, len);
+            return true;
+        }
+    private:
+        const char *cp, *end;
+};
+
+static Table *readCacheTable(CacheReader &reader, int keysize, bool *ok) {
+    long long count;
+    *ok = reader.get(count);
+    if (!*ok || count < 0)
+        return NULL;
+    const char *keys = reader.take(count * keysize * sizeof(KeySegment));
+    const char *values = reader.take(count * sizeof(double));
+    if (keys == NULL || values == NULL) {
+        *ok = false;
+        return NULL;
+    }
+    Table *table = new Table(keysize, count > 0 ? count : 1);
+    KeySegment *key = new KeySegment[keysize];
+    for (long long i = 0; i < count; i++) {
+        double value;
+        memcpy(key, keys + i * keysize * sizeof(KeySegment), keysize * sizeof(KeySegment));
+        memcpy(&value, values + i * sizeof(double), sizeof(double));
+        table->addTuple(key, value);
+    }
+    delete[] key;
+    return table;
+}
+
+//-- true if the file is a data cache, rather than a text data file
+static bool isDataCache(FILE *fd) {
+    char magic[sizeof(dataCacheMagic)];
+    return ftell(fd) == 0 && pread(fileno(fd), magic, sizeof(magic), 0) == (ssize_t) sizeof(magic)
+            && memcmp(magic, dataCacheMagic, sizeof(magic)) == 0;
+}
+
+/*
+ * ocReadDataCache - load a data cache; return the number of data lines in the data file
+ * it was made from, or 0 if it can't be read.
+ */
+static int ocReadDataCache(FILE *fd, Options *options, Table **indata, Table **testdata, VariableList *vars) {
+    MappedFile mapped;
+    if (!mapped.open(fd)) {
+        printf("ERROR: unable to map data cache\n");
+        return 0;
+    }
+    CacheReader reader(mapped.start, mapped.end);
+    int version, dataLines, varCount, keysize;
+    std::string header;
+    bool ok = reader.take(sizeof(dataCacheMagic)) && reader.get(version) && version == dataCacheVersion
+            && reader.get(dataLines) && reader.getString(header) && reader.get(varCount) && varCount >= 0;
+    //-- the options text is read just as it was from the data file
+    if (ok && header.size() > 0) {
+        FILE *headerFd = fmemopen(&header[0], header.size(), "r");
+        if (headerFd) {
+            options->readOptions(headerFd);
+            fclose(headerFd);
+        } else {
+            ok = false;
+        }
+    }
+    for (int i = 0; ok && i < varCount; i++) {
+        std::string name, abbrev, value;
+        int cardinality, segment, shift, size, valueCount;
+        char dv;
+        KeySegment mask;
+        ok = reader.getString(name) && reader.getString(abbrev) && reader.get(cardinality) && reader.get(segment)
+                && reader.get(shift) && reader.get(size) && reader.get(dv) && reader.get(mask)
+                && reader.get(valueCount) && cardinality >= 0 && cardinality <= MAXCARDINALITY && valueCount >= 0
+                && valueCount <= cardinality;
+        if (!ok)
+            break;
+        vars->addVariable(name.c_str(), abbrev.c_str(), cardinality, dv != 0);
+        int index = vars->getVarCount() - 1;
+        Variable *varp = vars->getVariable(index);
+        varp->segment = segment;
+        varp->shift = shift;
+        varp->size = size;
+        varp->mask = mask;
+        for (int j = 0; ok && j < valueCount; j++) {
+            ok = reader.getString(value) && vars->getVarValueIndex(index, value.c_str()) == j;
+        }
+    }
+    ok = ok && reader.get(keysize) && keysize == vars->getKeySize();
+    if (ok)
+        *indata = readCacheTable(reader, keysize, &ok);
+    if (ok)
+        *testdata = readCacheTable(reader, keysize, &ok);
+    if (!ok) {
+        printf("ERROR: data cache is damaged or from another version of OCCAM\n");
+        return 0;
+    }
+    return *indata ? dataLines : 0;
+}
+
 /*
  * oldRead - read old format files.
  */
@@ -618,24 +1442,65 @@ int ocReadFile(FILE *fd, Options *options, Table **indata, Table **testdata, Var
     int dataLines = 0;
     int testLines = 0;
     *vars = varp = new VariableList(8);
+    if (fd && isDataCache(fd))
+        return ocReadDataCache(fd, options, indata, testdata, varp);
+    long headerEnd = 0;
     if (fd) {
         options->readOptions(fd);
+        headerEnd = ftell(fd);
     }
     ocRebinDefineVar(options, varp, &lostvarp);
-    //-- If not at end of file, there is data in this file
-    if (!feof(fd)) {
+    double threadOption, readMemory;
+    if (!options->getOptionFloat("read-threads", NULL, &threadOption))
+        threadOption = 0;
+    if (!options->getOptionFloat("read-memory", NULL, &readMemory))
+        readMemory = 0;
+    DataRuns dataRuns(varp->getKeySize(), readMemory), testRuns(varp->getKeySize(), readMemory);
+    MappedFile mapped;
+    if (!feof(fd) && mapped.open(fd)) {
+        //-- read the data, and any test data after it, from memory
+        const char *next;
         *indata = indatap = new Table(varp->getKeySize(), 64);
-        dataLines = ocReadData(fd, varp, indatap, lostvarp);
-        indatap->sort();
-    }
-    //-- If there's still data, then it must be test data
-    if (!feof(fd)) {
-        *testdata = testdatap = new Table(varp->getKeySize(), 64);
-        testLines = ocReadData(fd, varp, testdatap, lostvarp);
-        testdatap->sort();
+        indatap->beginHashAccumulation();
+        dataLines = ocReadMappedData(mapped.start, mapped.end, &next, varp, indatap, lostvarp, &dataRuns,
+                (int) threadOption);
+        *indata = indatap = dataRuns.finish(indatap);
+        if (next) {
+            *testdata = testdatap = new Table(varp->getKeySize(), 64);
+            testdatap->beginHashAccumulation();
+            testLines = ocReadMappedData(next, mapped.end, &next, varp, testdatap, lostvarp, &testRuns,
+                    (int) threadOption);
+            *testdata = testdatap = testRuns.finish(testdatap);
+        }
+    } else {
+        //-- If not at end of file, there is data in this file
+        if (!feof(fd)) {
+            *indata = indatap = new Table(varp->getKeySize(), 64);
+            indatap->beginHashAccumulation();
+            dataLines = ocReadData(fd, varp, indatap, lostvarp, &dataRuns);
+            *indata = indatap = dataRuns.finish(indatap);
+        }
+        //-- If there's still data, then it must be test data
+        if (!feof(fd)) {
+            *testdata = testdatap = new Table(varp->getKeySize(), 64);
+            testdatap->beginHashAccumulation();
+            testLines = ocReadData(fd, varp, testdatap, lostvarp, &testRuns);
+            *testdata = testdatap = testRuns.finish(testdatap);
+        }
     }
     bool result = varp->checkCardinalities();
     if (result == false)
         exit(1);
+    //-- save what was read as a data cache, if asked; the options text is reread
+    //-- from the start of the file
+    const char *cacheFile;
+    if (options->getOptionString("data-cache-file", NULL, &cacheFile)) {
+        std::string header(headerEnd > 0 ? headerEnd : 0, '\0');
+        if (headerEnd < 0 || pread(fileno(fd), &header[0], header.size(), 0) != (ssize_t) header.size()) {
+            printf("WARNING: unable to write data cache %s: data file is not seekable\n", cacheFile);
+        } else if (!ocWriteDataCache(cacheFile, header, varp, indatap, testdatap, dataLines)) {
+            printf("WARNING: unable to write data cache %s\n", cacheFile);
+        }
+    }
     return dataLines;
 }
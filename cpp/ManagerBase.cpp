@@ -15,6 +15,7 @@
 #include "ManagerBase.h"
 #include "OccamMath.h"
 #include "Model.h"
+#include "Parallel.h"
 #include "ModelCache.h"
 #include "Options.h"
 #include "RelCache.h"
@@ -32,6 +33,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <algorithm>
+#include <atomic>
 using std::min;
 using std::make_pair;
 using std::pair;
@@ -119,6 +121,13 @@ void fpe_handler(int sig) {
 
 const int defaultRelSize = 10;
 
+//-- projections onto relations with at most this many cells use a direct-indexed array
+const long long MAX_DENSE_PROJECTION_CELLS = 1 << 22;
+//-- relation tables over at most this many cells get a dense index for lookups
+const long long MAX_DENSE_INDEX_CELLS = 1 << 20;
+//-- IPF fits smaller than this many tuples per thread aren't worth splitting up
+const long long MIN_IPF_TUPLES_PER_THREAD = 16384;
+
 //#define LOG_PROJECTIONS
 #ifdef LOG_PROJECTIONS
 static FILE *projfd = NULL;
@@ -154,14 +163,15 @@ ManagerBase::ManagerBase(VariableList *vars, Table *input) :
     fitTable1 = NULL;
     fitTable2 = NULL;
     projTable = NULL;
+    threadWork = NULL;
+    threadWorkCount = 0;
+    workspacePeakBytes = 0;
     inputData = testData = NULL;
     DVOrder = NULL;
     searchDirection = Direction::Ascending;
+    keepFits = false;
     useInverseNotation = 0;
     valuesAreFunctions = false;
-    intersectArray = NULL;
-    intersectCount = 0;
-    intersectMax = 1;
     functionConstant = 0;
     negativeConstant = 0;
     signal(SIGSEGV, segfault_handler);
@@ -179,7 +189,10 @@ ManagerBase::~ManagerBase() {
     if (fitTable1) delete fitTable1;
     if (fitTable2) delete fitTable2;
     if (projTable) delete projTable;
-    if (intersectArray) delete[] intersectArray;
+    for (int t = 0; t < threadWorkCount; t++) {
+        delete threadWork[t];
+    }
+    if (threadWork) delete[] threadWork;
     if (DVOrder) delete[] DVOrder;
     delete options;
     delete modelCache;
@@ -245,6 +258,19 @@ int ManagerBase::addConstraint(int varcount, int *varindices, int *stateindices,
 //-- look in relCache and, if not found, make a new relation and store in relCache
 // *** warning: this function sorts varindices in place ***
 Relation *ManagerBase::getRelation(int *input_vars, int varcount, bool make_project, int *input_states) {
+    //-- a cached variable-based relation is found by its mask, without building
+    //-- a relation or its name
+    if (input_states == NULL) {
+        KeySegment mask[keysize];
+        Key::buildMask(mask, keysize, varList, input_vars, varcount);
+        Relation *rel = relCache->findRelation(mask, keysize);
+        if (rel) {
+            if (make_project) {
+                makeProjection(rel);
+            }
+            return rel;
+        }
+    }
     int* varindices = new int[varcount];
     memcpy(varindices, input_vars, varcount * sizeof(int));
     int* stateindices = NULL;
@@ -270,8 +296,8 @@ Relation *ManagerBase::getRelation(int *input_vars, int varcount, bool make_proj
         for (int i = 0; i < varcount; i++) {
             rel->addVariable(varindices[i], stateindices[i]);
         }
-        if (!relCache->addRelation(rel)) {
-            Relation *cached_rel = relCache->findRelation(rel->getPrintName());
+        Relation *cached_rel = relCache->findOrAddRelation(rel);
+        if (cached_rel != rel) {
             delete rel;
             rel = cached_rel;
         } else {
@@ -297,8 +323,8 @@ Relation *ManagerBase::getRelation(int *input_vars, int varcount, bool make_proj
         for (int i = 0; i < varcount; i++) {
             rel->addVariable(varindices[i]);
         }
-        if (!relCache->addRelation(rel)) {
-            Relation *cached_rel = relCache->findRelation(rel->getPrintName());
+        Relation *cached_rel = relCache->findOrAddRelation(rel);
+        if (cached_rel != rel) {
             delete rel;
             rel = cached_rel;
         }
@@ -340,9 +366,16 @@ bool ManagerBase::makeProjection(Relation *rel) {
         start_size = inputData->getTupleCount();
     }
     //logProjection(rel->getPrintName());
-    Table *table = new Table(keysize, start_size);
+    Table *table = new Table(keysize, start_size, TableType::InformationTheoretic, TableLayout::Columnar);
     rel->setTable(table);
     makeProjection(inputData, table, rel);
+
+    //-- small relations (not too sparsely populated) are looked up through a dense index
+    long long nc = rel->getNC();
+    if (!rel->isStateBased() && nc > 0 && nc <= MAX_DENSE_INDEX_CELLS
+            && nc <= 8 * table->getTupleCount() + 4096) {
+        table->buildDenseIndex(varList, rel->getVariables(), rel->getVariableCount());
+    }
     return true;
 }
 
@@ -365,6 +398,16 @@ bool ManagerBase::makeProjection(Table *t1, Table *t2, Relation *rel) {
         c_count = rel->getStateConstraints()->getConstraintCount();
         makeSbExpansion(rel, t2);
     }
+    long long nc = rel->getNC();
+    //-- small relations are summed into a direct-indexed array, which comes out already sorted
+    if (!rel->isStateBased() && nc > 0 && nc <= MAX_DENSE_PROJECTION_CELLS && nc <= 4 * count + 256) {
+        if (makeDenseProjection(t1, t2, rel, nc)) {
+            delete[] key;
+            return true;
+        }
+    }
+    //-- otherwise accumulate through the table's hash, and sort once at the end
+    t2->beginHashAccumulation((nc > 0 && nc < count) ? nc : count);
     for (i = 0; i < count; i++) {
         t1->copyKey(i, key);
         value = t1->getValue(i);
@@ -410,11 +453,69 @@ bool ManagerBase::makeProjection(Table *t1, Table *t2, Relation *rel) {
             }
         }
     }
-    t2->sort();
+    t2->finalize();
     delete[] key;
     return true;
 }
 
+bool ManagerBase::makeDenseProjection(Table *t1, Table *t2, Relation *rel, long long nc) {
+    //-- each cell index is a mixed-radix number over the relation's variables, with the
+    //-- last variable varying fastest. Variables are packed into keys from the high bits
+    //-- down in index order, so walking the cells in order produces keys in sorted order.
+    int varCount = rel->getVariableCount();
+    int *vars = rel->getVariables();
+    int segment[varCount], shift[varCount], card[varCount];
+    KeySegment varMask[varCount];
+    long long stride[varCount];
+    long long s = 1;
+    for (int v = varCount - 1; v >= 0; v--) {
+        Variable *var = varList->getVariable(vars[v]);
+        segment[v] = var->segment;
+        shift[v] = var->shift;
+        varMask[v] = var->mask;
+        card[v] = var->cardinality;
+        stride[v] = s;
+        s *= card[v];
+    }
+
+    double *cells = new double[nc];
+    bool *used = new bool[nc];
+    memset(cells, 0, nc * sizeof(double));
+    memset(used, 0, nc * sizeof(bool));
+    long long count = t1->getTupleCount();
+    for (long long i = 0; i < count; i++) {
+        KeySegment *key = t1->getKey(i);
+        long long cell = 0;
+        for (int v = 0; v < varCount; v++) {
+            int value = (key[segment[v]] & varMask[v]) >> shift[v];
+            if (value >= card[v]) {
+                delete[] cells;
+                delete[] used;
+                return false;
+            }
+            cell += value * stride[v];
+        }
+        cells[cell] += t1->getValue(i);
+        used[cell] = true;
+    }
+
+    KeySegment key[keysize];
+    memcpy(key, rel->getMask(), keysize * sizeof(KeySegment));
+    for (long long cell = 0; cell < nc; cell++) {
+        if (!used[cell]) continue;
+        long long rem = cell;
+        for (int v = 0; v < varCount; v++) {
+            KeySegment value = rem / stride[v];
+            rem -= value * stride[v];
+            key[segment[v]] = (key[segment[v]] & ~varMask[v]) | ((value << shift[v]) & varMask[v]);
+        }
+        t2->addTuple(key, cells[cell]);
+    }
+    delete[] cells;
+    delete[] used;
+    return true;
+}
+
 bool ManagerBase::makeMaxProjection(Table *qt, Table *maxpt, Table *inputData, Relation *indRel,
         Relation *depRel, double *missedValues) {
     //-- create the max projection data for the IV relation, used for computing percent correct.
@@ -687,7 +788,7 @@ bool ManagerBase::makeProjections(Model *model) {
 }
 
 void ManagerBase::deleteTablesFromCache() {
-    relCache->deleteTables();
+    relCache->deleteTables(inputData);
 }
 
 bool ManagerBase::deleteModelFromCache(Model *model) {
@@ -697,25 +798,18 @@ bool ManagerBase::deleteModelFromCache(Model *model) {
 //-- intersect two variable lists, producing a third. returns true if intersection
 //-- is not empty, and returns the list and count of common variables
 static bool intersect(Relation *rel1, Relation *rel2, int* &var, int &count) {
-    int *var1, *var2;
-    int count1, count2;
-    count1 = rel1->getVariableCount();
-    var1 = rel1->getVariables();
-    count2 = rel2->getVariableCount();
-    var2 = rel2->getVariables();
-
     var = NULL;
     count = 0;
-    for (int i = 0; i < count1; i++) {
-        for (int j = 0; j < count2; j++) {
-            if (var1[i] == var2[j]) {
-                if (var == NULL)
-                    var = new int[count1]; //this is sure to be large enough
-                var[count++] = var1[i];
-            }
-        }
-    }
-    return var != NULL;
+    const VarSet &set1 = rel1->getVarSet();
+    const VarSet &set2 = rel2->getVarSet();
+    if (!set1.intersects(set2))
+        return false;
+    VarSet common(set1);
+    common.intersectWith(set2);
+    int count1 = rel1->getVariableCount();
+    var = new int[count1]; //this is sure to be large enough
+    count = common.copyVariables(var, count1);
+    return true;
 }
 
 
@@ -918,107 +1012,156 @@ struct DFAndHProc: public ocIntersectProcessor {
 
 void ManagerBase::calculateDfAndEntropy(Model *model) {
     if ((model->getAttribute(ATTRIBUTE_DF) < 0) || (model->getAttribute(ATTRIBUTE_ALG_H) < 0)) {
-        DFAndHProc processor(this);
-        if (intersectArray != NULL) {
-            delete[] intersectArray;
-            intersectCount = 0;
-            intersectMax = model->getRelationCount();
-            intersectArray = NULL;
+        //-- a model made from a progenitor (in a search) differs from it in a few
+        //-- relations, so adjust the progenitor's sums for those
+        Model *progenitor = model->getProgenitor();
+        if (progenitor && progenitor != model && !model->isStateBased() && !progenitor->isStateBased()
+                && progenitor->getAttribute(ATTRIBUTE_DF) >= 0 && progenitor->getAttribute(ATTRIBUTE_ALG_H) >= 0) {
+            calculateDfAndEntropy(model, progenitor);
+            return;
         }
+        DFAndHProc processor(this);
         doIntersectionProcessing(model, &processor);
         model->setAttribute(ATTRIBUTE_DF, processor.df);
         model->setAttribute(ATTRIBUTE_ALG_H, processor.h);
     }
 }
 
-void ManagerBase::doIntersectionProcessing(Model *model, ocIntersectProcessor *proc) {
-    //-- allocate intersect storage; this grows later if needed
-    if (intersectArray == NULL) {
-        intersectMax = model->getRelationCount();
-        intersectArray = new VarIntersect[intersectMax];
+//-- DF and H of a model from those of another model over the same variables. The
+//-- inclusion-exclusion sum Q over a set of relations S satisfies
+//--     Q(S + x) = Q(S) + f(x) - Q({s ^ x : s in S})
+//-- so each relation of the progenitor not in the model is taken out, and each relation
+//-- of the model not in the progenitor is put in, with only the projections onto that
+//-- relation to sum. Relations shared by the two are never revisited.
+void ManagerBase::calculateDfAndEntropy(Model *model, Model *progenitor) {
+    int progCount = progenitor->getRelationCount();
+    int modelCount = model->getRelationCount();
+    Relation **rels = new Relation*[progCount + modelCount];
+    Relation **proj = new Relation*[progCount + modelCount];
+    int count = 0;
+    int i, j;
+    double df = progenitor->getAttribute(ATTRIBUTE_DF);
+    double h = progenitor->getAttribute(ATTRIBUTE_ALG_H);
+    for (i = 0; i < progCount; i++) {
+        rels[count++] = progenitor->getRelation(i);
+    }
+    //-- relations are unique in the cache, so they can be matched by pointer
+    for (i = 0; i < count;) {
+        Relation *rel = rels[i];
+        for (j = 0; j < modelCount && model->getRelation(j) != rel; j++)
+            ;
+        if (j < modelCount) {
+            i++;
+            continue;
+        }
+        rels[i] = rels[--count];
+        df -= computeDF(rel);
+        h -= computeH(rel);
+        int projCount = projectRelations(rels, count, rel, proj);
+        addIntersectionTerms(proj, projCount, 1, df, h);
+    }
+    for (j = 0; j < modelCount; j++) {
+        Relation *rel = model->getRelation(j);
+        for (i = 0; i < progCount && progenitor->getRelation(i) != rel; i++)
+            ;
+        if (i < progCount)
+            continue;
+        df += computeDF(rel);
+        h += computeH(rel);
+        int projCount = projectRelations(rels, count, rel, proj);
+        addIntersectionTerms(proj, projCount, -1, df, h);
+        rels[count++] = rel;
+    }
+    delete[] proj;
+    delete[] rels;
+    model->setAttribute(ATTRIBUTE_DF, df);
+    model->setAttribute(ATTRIBUTE_ALG_H, h);
+}
+
+//-- the nonempty intersections of the given relations with rel, leaving out any which
+//-- are contained in another (which doesn't change the sum over them)
+int ManagerBase::projectRelations(Relation **rels, int count, Relation *rel, Relation **proj) {
+    int projCount = 0;
+    int *vars, varCount;
+    for (int i = 0; i < count; i++) {
+        if (!intersect(rels[i], rel, vars, varCount))
+            continue;
+        Relation *newRel = getRelation(vars, varCount, true);
+        delete[] vars;
+        bool contained = false;
+        for (int k = 0; k < projCount;) {
+            if (proj[k]->contains(newRel)) {
+                contained = true;
+                break;
+            }
+            if (newRel->contains(proj[k]))
+                proj[k] = proj[--projCount];
+            else
+                k++;
+        }
+        if (!contained)
+            proj[projCount++] = newRel;
     }
+    return projCount;
+}
+
+//-- add sign times the inclusion-exclusion sums of DF and H over the given relations,
+//-- none of which contains another, to df and h
+void ManagerBase::addIntersectionTerms(Relation **rels, int count, double sign, double &df, double &h) {
+    if (count == 0)
+        return;
+    Relation **proj = new Relation*[count];
+    for (int n = count - 1; n >= 0; n--) {
+        df += sign * computeDF(rels[n]);
+        h += sign * computeH(rels[n]);
+        int projCount = projectRelations(rels, n, rels[n], proj);
+        addIntersectionTerms(proj, projCount, -sign, df, h);
+    }
+    delete[] proj;
+}
+
+void ManagerBase::doIntersectionProcessing(Model *model, ocIntersectProcessor *proc) {
     int count = model->getRelationCount();
-    VariableList *varList = model->getRelation(0)->getVariableList();
     Relation *rel;
-    int i, j, k;
-    //-- go through the relations in the model and create VarIntersect entries
+    int i, j;
+    //-- the model's relations are the first level of terms; each is the
+    //-- intersection of itself alone
+    VarIntersectLevel *current = &intersectLevels[0];
+    VarIntersectLevel *next = &intersectLevels[1];
+    current->clear();
     for (i = 0; i < count; i++) {
         rel = model->getRelation(i);
-        while (intersectCount >= intersectMax) {
-            intersectArray = (VarIntersect*) growStorage(intersectArray, sizeof(VarIntersect)*intersectMax, 2);
-            intersectMax *= 2;
-        }
-        VarIntersect *intersect = intersectArray + (intersectCount++);
-        intersect->rel = rel;
-        intersect->startIndex = i;
-        intersect->sign = true;
-        intersect->count = 1;
-        proc->process(intersect->sign, intersect->rel, intersect->count);
-    }
-    int level0end = intersectCount;
+        proc->process(true, rel, 1);
+        current->add(rel, i, true, 1);
+    }
     bool sign = true;
-    bool match;
 
     //-- given the previous level of intersection terms, construct the next level from
-    //-- all intersections among the previous level. When an intersection is found, we
-    //-- need to check the new intersections. If there is a match, we update its
-    //-- include count; if there is no match, we create a new one. This process
-    //-- terminates when no new terms have been added.
-    VarIntersect *ip, *jp, *newp;
-    VarIntersect *currentArray, *nextArray;
-    int currentCount, nextCount;
-    int nextMax;
+    //-- the intersections of each term with the relations after its start index. Each
+    //-- term is passed to the processor as it is made. Terms with the same relation and
+    //-- start index lead to the same intersections later on, so these are merged in the
+    //-- next level and their counts added. This terminates when a level is empty.
     int *newvars, newcount;
-    currentArray = intersectArray;
-    currentCount = intersectCount;
-    while (currentCount > 0) {
+    while (current->size() > 0) {
         sign = !sign;
-        nextArray = new VarIntersect[intersectMax];
-        nextCount = 0;
-        nextMax = intersectMax;
-        for (i = 0; i < currentCount; i++) {
-            for (j = currentArray[i].startIndex + 1; j < level0end; j++) {
-                ip = currentArray + i;
-                jp = intersectArray + j;
-                if (intersect(ip->rel, jp->rel, newvars, newcount)) {
+        next->clear();
+        for (i = 0; i < current->size(); i++) {
+            VarIntersect &term = (*current)[i];
+            for (j = term.startIndex + 1; j < count; j++) {
+                if (intersect(term.rel, model->getRelation(j), newvars, newcount)) {
                     rel = getRelation(newvars, newcount, true);
-                    proc->process(sign, rel, ip->count);
-                    // only add the relation to the intersect array if it has any potential for overlap.
-                    // (when j==(level0end-1), that relation can be part of no further overlaps)
-                    if (j < (level0end - 1)) {
-                        match = false;
-                        for (k = 0; k < nextCount; k++) {
-                            if ((nextArray[k].rel == rel) && (nextArray[k].startIndex == j)) {
-                                match = true;
-                                nextArray[k].count += ip->count;
-                                break;
-                            }
-                        }
-                        if (!match) {
-                            while (nextCount >= nextMax) {
-                                nextArray = (VarIntersect*) growStorage(nextArray, sizeof(VarIntersect)*nextMax, 2);
-                                nextMax *= 2;
-                            }
-                            newp = nextArray + (nextCount++);
-                            newp->rel = rel;
-                            newp->startIndex = j;
-                            newp->sign = sign;
-                            newp->count = ip->count;
-                        }
-                    }
+                    proc->process(sign, rel, term.count);
+                    // only add the relation to the next level if it has any potential for overlap.
+                    // (when j==(count-1), that relation can be part of no further overlaps)
+                    if (j < (count - 1))
+                        next->add(rel, j, sign, term.count);
                     delete[] newvars;
                 }
             }
         }
-        if (currentArray != intersectArray) {
-            delete[] currentArray;
-        }
-        currentArray = nextArray;
-        nextArray = NULL;
-        currentCount = nextCount;
-    }
-    if (currentArray != intersectArray) {
-        delete[] currentArray;
+        VarIntersectLevel *swap = current;
+        current = next;
+        next = swap;
     }
 }
 
@@ -1305,9 +1448,9 @@ Model *ManagerBase::makeModel(const char *name, bool makeProject) {
     delete[] relname;
 
     //-- put it in the cache; return the cached one if present
-    if (!modelCache->addModel(model)) {
+    Model *cachedModel = modelCache->findOrAddModel(model);
+    if (cachedModel != model) {
         //-- already exists in cache; return that one
-        Model *cachedModel = modelCache->findModel(model->getPrintName());
         delete model;
         model = cachedModel;
     }
@@ -1373,9 +1516,9 @@ Model *ManagerBase::makeSbModel(const char *name, bool makeProject) {
     model->completeSbModel();
 
     //-- put it in the cache; return the cached one if present
-    if (!modelCache->addModel(model)) {
+    Model *cachedModel = modelCache->findOrAddModel(model);
+    if (cachedModel != model) {
         //-- already exists in cache; return that one
-        Model *cachedModel = modelCache->findModel(model->getPrintName());
         delete model;
         model = cachedModel;
     }
@@ -1402,6 +1545,7 @@ void ManagerBase::printSizes() {
     printf("Rel-cache: %ld; ", size);
     size = modelCache->size();
     printf("Model cache: %ld; ", size);
+    printf("Fit workspace peak: %lld; ", workspacePeakBytes);
     //	relCache->dump();
     modelCache->dump();
 }
@@ -1421,7 +1565,7 @@ void ManagerBase::fitTestAlgebraic(Model* model, Table* algTable, double missing
         if (inputData->indexOf(tupleKey) == -1) {
             double outValue = 1;
             
-            // for each item in intersectArray
+            // for each intersection term
             for (auto it=fitIs.begin(); it != fitIs.end(); ++it) {
                 // get value from relation for masked key
                 double value = it->first->getMatchingTupleValue(tupleKey);
@@ -1453,7 +1597,15 @@ bool ManagerBase::makeFitTableAlgebraic(Model* model) {
     double missingCard = getMissingCardinalityFactor(model);
     
     long long inSize = inputData->getTupleCount();
-    Table *algTable = new Table(keysize, inSize);
+    //-- the previous fit table is reused for the result, if there is one
+    Table *algTable = fitTable1;
+    if (algTable) {
+        algTable->reset(keysize);
+        algTable->reserve(inSize);
+    } else {
+        algTable = new Table(keysize, inSize, TableType::InformationTheoretic, TableLayout::Columnar);
+    }
+    algTable->beginHashAccumulation(inSize);
 
     // for every tuple in training data:
     for (long long ti = 0; ti < inSize; ti++) {
@@ -1478,9 +1630,9 @@ bool ManagerBase::makeFitTableAlgebraic(Model* model) {
 
     if (testData) { fitTestAlgebraic(model, algTable, missingCard, fitIs); }
 
-    algTable->sort();
-    if (fitTable1) delete fitTable1;
+    algTable->finalize();
     fitTable1 = algTable;
+    updateWorkspacePeak();
  
     return true;
 }
@@ -1488,22 +1640,39 @@ bool ManagerBase::makeFitTableAlgebraic(Model* model) {
 bool ManagerBase::makeFitTableIPF(Model* model) {
     // For looped & SB models, proceed to solve with IPF.
     stateSpaceSize = (unsigned long long) ocDegreesOfFreedom(varList) + 1;
-    if (!fitTable1) {
-        //-- for large state spaces, start with less space and let it grow.
-        if (stateSpaceSize > 1000000)
-            stateSpaceSize = 1000000;
-        fitTable1 = new Table(keysize, stateSpaceSize);
-    }
-    if (!fitTable2) {
-        if (stateSpaceSize > 1000000)
-            stateSpaceSize = 1000000;
-        fitTable2 = new Table(keysize, stateSpaceSize);
-    }
-    if (!projTable) {
-        if (stateSpaceSize > 1000000)
-            stateSpaceSize = 1000000;
-        projTable = new Table(keysize, stateSpaceSize);
+    double threadOption;
+    if (!getOptionFloat("ipf-threads", NULL, &threadOption)) threadOption = 1;
+    //-- lend the manager's fit tables to its workspace for the fit, and take them back
+    ipfWork.fitTable1 = fitTable1;
+    ipfWork.fitTable2 = fitTable2;
+    ipfWork.projTable = projTable;
+    bool fitted = fitIPF(model, ipfWork, (int) threadOption);
+    fitTable1 = ipfWork.fitTable1;
+    fitTable2 = ipfWork.fitTable2;
+    projTable = ipfWork.projTable;
+    ipfWork.fitTable1 = ipfWork.fitTable2 = ipfWork.projTable = NULL;
+    updateWorkspacePeak();
+    return fitted;
+}
+
+bool ManagerBase::fitIPF(Model* model, FitWorkspace &work, int ipfThreads) {
+    //-- for large state spaces, start with less space and let it grow.
+    long long startSize = (long long) ocDegreesOfFreedom(varList) + 1;
+    if (startSize > 1000000)
+        startSize = 1000000;
+    if (!work.fitTable1) {
+        work.fitTable1 = new Table(keysize, startSize, TableType::InformationTheoretic, TableLayout::Columnar);
+    }
+    if (!work.fitTable2) {
+        work.fitTable2 = new Table(keysize, startSize, TableType::InformationTheoretic, TableLayout::Columnar);
     }
+    if (!work.projTable) {
+        work.projTable = new Table(keysize, startSize, TableType::InformationTheoretic, TableLayout::Columnar);
+    }
+    //-- the fit runs in the workspace's tables, not the manager's
+    Table *&fitTable1 = work.fitTable1;
+    Table *&fitTable2 = work.fitTable2;
+    Table *&projTable = work.projTable;
     fitTable1->reset(keysize);
     fitTable2->reset(keysize);
     projTable->reset(keysize);
@@ -1522,20 +1691,6 @@ bool ManagerBase::makeFitTableIPF(Model* model) {
         maskList[r] = model->getRelation(r)->getMask();
     }
 
-    // compute the number of nonzero tuples in the expansion of each relation, and start
-    // with the one where this is smallest (to minimize memory usage)
-    int startRel = 0;
-    double expsize = relList[0]->getExpansionSize();
-    double newexpsize;
-    for (int r = 1; r < relCount; r++) {
-        newexpsize = relList[r]->getExpansionSize();
-        if (newexpsize < expsize) {
-            startRel = r;
-            expsize = newexpsize;
-        }
-    }
-    makeOrthoExpansion(relList[startRel], fitTable1);
-
     // configurable fitting parameters:  convergence error. This is approximately in units of samples.
     // if initial data was probabilities, an artificial scale of 1000 is used.
     double delta2;
@@ -1550,6 +1705,48 @@ bool ManagerBase::makeFitTableIPF(Model* model) {
         getOptionFloat("ipf-maxit", NULL, &maxiter);
     }
 
+    //-- with ipf-warm-start, a looped model whose progenitor is a submodel of it starts
+    //-- from the progenitor's fit. That fit already matches the shared marginals, so the
+    //-- relations that are new in this model are scaled first. IPF then stops at a
+    //-- different point within ipf-maxdev than a cold start, which can move statistics
+    //-- and reorder nearly tied models.
+    Model *progen = model->getProgenitor();
+    double warmOption;
+    if (!getOptionFloat("ipf-warm-start", NULL, &warmOption)) warmOption = 0;
+    if (warmOption > 0 && maxiter > 1 && !model->isStateBased() && progen && progen != model
+            && progen->getFitTable() && model->containsModel(progen)) {
+        Table *progenFit = progen->getFitTable();
+        fitTable1->reserve(progenFit->getTupleCount());
+        fitTable2->reserve(progenFit->getTupleCount());
+        fitTable1->copy(progenFit);
+        int first = 0;
+        for (int r = 0; r < relCount; r++) {
+            if (!progen->containsRelation(relList[r])) {
+                std::swap(relList[first], relList[r]);
+                std::swap(tableList[first], tableList[r]);
+                std::swap(maskList[first], maskList[r]);
+                first++;
+            }
+        }
+    } else {
+        // compute the number of nonzero tuples in the expansion of each relation, and start
+        // with the one where this is smallest (to minimize memory usage)
+        int startRel = 0;
+        double expsize = relList[0]->getExpansionSize();
+        double newexpsize;
+        for (int r = 1; r < relCount; r++) {
+            newexpsize = relList[r]->getExpansionSize();
+            if (newexpsize < expsize) {
+                startRel = r;
+                expsize = newexpsize;
+            }
+        }
+        //-- make room for the whole expansion up front, rather than growing into it
+        fitTable1->reserve((long long) expsize);
+        fitTable2->reserve((long long) expsize);
+        makeOrthoExpansion(relList[startRel], fitTable1);
+    }
+
     int iter, r;
     long long i, j;
     long long tupleCount;
@@ -1557,6 +1754,13 @@ bool ManagerBase::makeFitTableIPF(Model* model) {
     Relation *rel;
     Table *table;
     KeySegment *mask;
+    if (!model->isStateBased()) {
+        iter = scaleIndexedIPF(work, relCount, tableList, maskList, maxiter, delta2, error, ipfThreads);
+        model->setAttribute(ATTRIBUTE_IPF_ITERATIONS, (double) iter);
+        model->setAttribute(ATTRIBUTE_IPF_ERROR, error);
+        delete[] key;
+        return true;
+    }
     for (iter = 0; iter < maxiter; iter++) {
         error = 0.0; // absolute difference between original projection and computed values
         for (r = 0; r < relCount; r++) {
@@ -1614,89 +1818,399 @@ bool ManagerBase::makeFitTableIPF(Model* model) {
     return true;
 }
 
+// grow a scratch block to hold at least count items. The old contents are not kept.
+template <typename T>
+static void reserveScratch(T *&block, long long &capacity, long long count) {
+    if (count <= capacity) return;
+    if (block) delete[] block;
+    block = new T[count];
+    capacity = count;
+}
+
+FitWorkspace::FitWorkspace() {
+    fitTable1 = fitTable2 = projTable = NULL;
+    ipfCells = NULL;
+    ipfCellsCapacity = 0;
+    ipfMarginals = NULL;
+    ipfMarginalsCapacity = 0;
+    ipfHistory = NULL;
+    ipfHistoryCapacity = 0;
+}
+
+FitWorkspace::~FitWorkspace() {
+    if (fitTable1) delete fitTable1;
+    if (fitTable2) delete fitTable2;
+    if (projTable) delete projTable;
+    if (ipfCells) delete[] ipfCells;
+    if (ipfMarginals) delete[] ipfMarginals;
+    if (ipfHistory) delete[] ipfHistory;
+}
+
+long long FitWorkspace::size() {
+    long long bytes = ipfCellsCapacity * sizeof(int)
+            + (ipfMarginalsCapacity + ipfHistoryCapacity) * sizeof(double);
+    if (fitTable1) bytes += fitTable1->size();
+    if (fitTable2) bytes += fitTable2->size();
+    if (projTable) bytes += projTable->size();
+    return bytes;
+}
+
+void ManagerBase::updateWorkspacePeak() {
+    long long bytes = ipfWork.size();
+    if (fitTable1) bytes += fitTable1->size();
+    if (fitTable2) bytes += fitTable2->size();
+    if (projTable) bytes += projTable->size();
+    for (int t = 0; t < threadWorkCount; t++) {
+        bytes += threadWork[t]->size();
+    }
+    if (bytes > workspacePeakBytes) workspacePeakBytes = bytes;
+}
+
+// IPF scaling for variable-based models. The relation marginal each fit tuple falls in
+// never changes, so it is looked up once per fit; every iteration is then a scatter of
+// the fit values into per-relation marginal arrays, and a gather to rescale them.
+// Tuples whose value drops to zero are kept (at zero) until the end, which gives the
+// same result as removing them on each pass. Returns the iteration count.
+//
+// With ipf-threads > 1, the fit tuples are split into one chunk per thread. Each thread
+// scatters its chunk into its own copy of the marginals; the copies are summed (each
+// thread summing a share of the cells), and then each thread rescales its chunk.
+//
+// With ipf-accel, the fit after every third sweep is extrapolated from the last three
+// (a SQUAREM step on the log values, which stays in the model's log-linear family, so
+// the fixed point is unchanged). The sweep after a jump is checked: if the error went
+// up, the jump is undone and the rest of the fit is plain IPF. The fit stops at a
+// different point within ipf-maxdev than plain IPF does, so statistics computed from it
+// can differ in the last reported digits unless ipf-maxdev is tightened.
+int ManagerBase::scaleIndexedIPF(FitWorkspace &work, int relCount, Table **tableList, KeySegment **maskList,
+        double maxiter, double delta2, double &error, int ipfThreads) {
+    Table *&fitTable1 = work.fitTable1;
+    Table *&fitTable2 = work.fitTable2;
+    long long tupleCount = fitTable1->getTupleCount();
+    ocTupleValue *values = fitTable1->getValueArray();
+    long long stride = fitTable1->getValueStride();
+
+    int threadCount = ocThreadCount(ipfThreads, tupleCount, MIN_IPF_TUPLES_PER_THREAD);
+
+    //-- cells[r][i] is the index of tuple i's marginal in relation r's table, or -1.
+    //-- partials[t * relCount + r] is thread t's share of relation r's marginals.
+    //-- These are carved out of the manager's scratch space.
+    long long marginalCount = 0;
+    for (int r = 0; r < relCount; r++) {
+        marginalCount += tableList[r]->getTupleCount();
+    }
+    reserveScratch(work.ipfCells, work.ipfCellsCapacity, relCount * tupleCount);
+    reserveScratch(work.ipfMarginals, work.ipfMarginalsCapacity, threadCount * marginalCount);
+    int *cells[relCount];
+    double *marginals[relCount];
+    double *partials[threadCount * relCount];
+    double *next = work.ipfMarginals;
+    for (int r = 0; r < relCount; r++) {
+        cells[r] = work.ipfCells + r * tupleCount;
+    }
+    for (int t = 0; t < threadCount; t++) {
+        for (int r = 0; r < relCount; r++) {
+            partials[t * relCount + r] = next;
+            next += tableList[r]->getTupleCount();
+        }
+    }
+    for (int r = 0; r < relCount; r++) {
+        marginals[r] = partials[r];
+    }
+    double threadError[threadCount];
+    int iter = 0;
+
+    //-- history holds the log fit values of the last two sweeps (the first one is
+    //-- replaced by the pre-jump fit values when an extrapolation is made)
+    double accelOption;
+    if (!getOptionFloat("ipf-accel", NULL, &accelOption)) accelOption = 0;
+    bool accelerate = accelOption > 0;
+    double *history[2] = { NULL, NULL };
+    double threadR2[threadCount], threadV2[threadCount];
+    bool threadBad[threadCount];
+    if (accelerate) {
+        reserveScratch(work.ipfHistory, work.ipfHistoryCapacity, 2 * tupleCount);
+        history[0] = work.ipfHistory;
+        history[1] = work.ipfHistory + tupleCount;
+    }
+    Barrier barrier(threadCount);
+
+    ocRunThreads(threadCount, [&](int t) {
+        long long first = tupleCount * t / threadCount;
+        long long last = tupleCount * (t + 1) / threadCount;
+        KeySegment key[keysize];
+        for (int r = 0; r < relCount; r++) {
+            for (long long i = first; i < last; i++) {
+                fitTable1->copyKey(i, key);
+                for (int k = 0; k < keysize; k++)
+                    key[k] |= maskList[r][k];
+                cells[r][i] = tableList[r]->indexOf(key);
+            }
+        }
+
+        bool accel = accelerate;
+        bool jumped = false;
+        double jumpError = 0.0;
+        int phase = 0;
+        int it;
+        for (it = 0; it < maxiter; it++) {
+            double localError = 0.0; // absolute difference between original projection and computed values
+            for (int r = 0; r < relCount; r++) {
+                Table *table = tableList[r];
+                int *cell = cells[r];
+                double *marginal = marginals[r];
+                double *partial = partials[t * relCount + r];
+                long long relTupleCount = table->getTupleCount();
+                //-- project the current fit onto the relation
+                memset(partial, 0, relTupleCount * sizeof(double));
+                for (long long i = first; i < last; i++) {
+                    if (cell[i] >= 0)
+                        partial[cell[i]] += values[i * stride];
+                }
+                if (threadCount > 1) {
+                    barrier.wait();
+                    long long cellFirst = relTupleCount * t / threadCount;
+                    long long cellLast = relTupleCount * (t + 1) / threadCount;
+                    for (long long c = cellFirst; c < cellLast; c++) {
+                        double sum = marginal[c];
+                        for (int u = 1; u < threadCount; u++) {
+                            sum += partials[u * relCount + r][c];
+                        }
+                        marginal[c] = sum;
+                    }
+                    barrier.wait();
+                }
+                //-- scale each tuple by the ratio of the input marginal to the computed one,
+                //-- zeroing it where either marginal is zero
+                for (long long i = first; i < last; i++) {
+                    double newValue = 0.0;
+                    if (cell[i] >= 0) {
+                        double relValue = table->getValue(cell[i]);
+                        if (relValue > DBL_EPSILON) {
+                            double projValue = marginal[cell[i]];
+                            if (projValue > DBL_EPSILON) {
+                                newValue = values[i * stride] * relValue / projValue;
+                            }
+                            localError = fmax(localError, fabs(relValue - projValue));
+                        }
+                    }
+                    values[i * stride] = (newValue > DBL_EPSILON) ? newValue : 0.0;
+                }
+            }
+            threadError[t] = localError;
+            barrier.wait();
+            double iterError = 0.0;
+            for (int u = 0; u < threadCount; u++) {
+                iterError = fmax(iterError, threadError[u]);
+            }
+            barrier.wait(); // everyone has read threadError before it is rewritten
+            if (t == 0) error = iterError;
+            if (iterError < delta2)         // check convergence
+                break;
+            if (!accel) continue;
+            double *x0 = history[0];
+            double *x1 = history[1];
+            if (jumped) {
+                jumped = false;
+                if (iterError > jumpError) {
+                    //-- the jump made things worse; go back to the fit before it
+                    for (long long i = first; i < last; i++) {
+                        values[i * stride] = x0[i];
+                    }
+                    accel = false;
+                    continue;
+                }
+            }
+            if (phase < 2) {
+                double *x = history[phase];
+                for (long long i = first; i < last; i++) {
+                    double value = values[i * stride];
+                    x[i] = value > 0.0 ? log(value) : 0.0;
+                }
+                phase++;
+                continue;
+            }
+            phase = 0;
+            //-- r = x1 - x0, v = (x2 - x1) - r; the step length is -|r|/|v|
+            double r2 = 0.0, v2 = 0.0;
+            for (long long i = first; i < last; i++) {
+                double value = values[i * stride];
+                if (value > 0.0) {
+                    double r = x1[i] - x0[i];
+                    double v = log(value) - x1[i] - r;
+                    r2 += r * r;
+                    v2 += v * v;
+                }
+            }
+            threadR2[t] = r2;
+            threadV2[t] = v2;
+            barrier.wait();
+            r2 = v2 = 0.0;
+            for (int u = 0; u < threadCount; u++) {
+                r2 += threadR2[u];
+                v2 += threadV2[u];
+            }
+            if (v2 <= 0.0 || r2 <= v2) continue;   // step no longer than plain IPF
+            double alpha = -sqrt(r2 / v2);
+            //-- keep the pre-jump fit in x0. A jump that sends any tuple out of
+            //-- (DBL_EPSILON, 1] is dropped as a whole, since clamping single
+            //-- tuples would move the fit off the model.
+            bool bad = false;
+            for (long long i = first; i < last; i++) {
+                double value = values[i * stride];
+                if (value > 0.0) {
+                    double r = x1[i] - x0[i];
+                    double v = log(value) - x1[i] - r;
+                    double jump = exp(x0[i] - 2 * alpha * r + alpha * alpha * v);
+                    if (!(jump > DBL_EPSILON && jump <= 1.0)) bad = true;
+                    values[i * stride] = jump;
+                }
+                x0[i] = value;
+            }
+            threadBad[t] = bad;
+            barrier.wait();
+            for (int u = 0; u < threadCount; u++) {
+                bad = bad || threadBad[u];
+            }
+            barrier.wait(); // everyone has read threadBad before it is rewritten
+            if (bad) {
+                for (long long i = first; i < last; i++) {
+                    values[i * stride] = x0[i];
+                }
+                continue;
+            }
+            jumped = true;
+            jumpError = iterError;
+        }
+        if (t == 0) iter = it;
+    });
+
+    //-- drop the zeroed tuples. fitTable1 is still sorted, so fitTable2 is too.
+    fitTable2->reset(keysize);
+    for (long long i = 0; i < tupleCount; i++) {
+        if (values[i * stride] > 0.0)
+            fitTable2->addTuple(fitTable1->getKey(i), values[i * stride]);
+    }
+    Table *ftswap = fitTable1;
+    fitTable1 = fitTable2;
+    fitTable2 = ftswap;
+
+    return iter;
+}
+
 bool ManagerBase::makeFitTable(Model *model) {
     
     if (model == nullptr) { return false; }
-    
+
     // Check for models that can be fit algorithmically. 
     // If so, solve that way.
 
-    else if (!hasLoops(model) 
+    bool fitted;
+    if (!hasLoops(model) 
           && !model->isStateBased() 
           && !getVariableList()->isDirected()) 
-        { return makeFitTableAlgebraic(model); }
+        { fitted = makeFitTableAlgebraic(model); }
     else 
-        { return makeFitTableIPF(model); }
-}
+        { fitted = makeFitTableIPF(model); }
 
-FitIntersectMap ManagerBase::computeIntersectLevels(Model* model) {
+    if (fitted) keepFit(model, fitTable1);
+    return fitted;
+}
 
-    // Allocate new workspace array
-    int fitIntersectCount = 0;
-    long fitIntersectMax = model->getRelationCount();
-    VarIntersect *fitIntersectArray = new VarIntersect[fitIntersectMax];
+bool ManagerBase::isWarmStarting() {
+    double warmOption;
+    if (!getOptionFloat("ipf-warm-start", NULL, &warmOption)) warmOption = 0;
+    return warmOption > 0 && searchDirection == Direction::Ascending;
+}
 
+//-- with ipf-warm-start, a model fitted while keepFits is set keeps a copy of its fit,
+//-- to seed the fits of the models derived from it. The search driver frees the copy
+//-- once the model's children are fitted, or when the model isn't kept.
+void ManagerBase::keepFit(Model *model, Table *fit) {
+    if (keepFits && isWarmStarting() && !model->isStateBased() && !model->getFitTable()) {
+        Table *copy = new Table(keysize, fit->getTupleCount(), TableType::InformationTheoretic,
+                TableLayout::Columnar);
+        copy->copy(fit);
+        model->setFitTable(copy);
+    }
+}
 
-    // Initialize the VarIntersects in the work array. 
-    for (int i = 0; i < fitIntersectMax; i++) {
-        Relation* rel = model->getRelation(i);
-        VarIntersect *intersect = fitIntersectArray + (fitIntersectCount++);
-        intersect->rel = rel;
-        intersect->startIndex = i;
-        intersect->sign = true;
+void ManagerBase::fitModels(Model **models, long count) {
+    double threadOption;
+    if (!getOptionFloat("search-threads", NULL, &threadOption)) threadOption = 1;
+
+    //-- collect the models that need an IPF fit, once each. Everything the fits share
+    //-- (relation projections and the caches behind them, the loop and print-name
+    //-- attributes) is set up here, so the threads below only read it.
+    Model **fitList = new Model*[count];
+    long fitCount = 0;
+    for (long i = 0; i < count; i++) {
+        Model *model = models[i];
+        if (model == NULL || model->isStateBased() || !hasLoops(model)
+                || model->getAttribute(ATTRIBUTE_FIT_H) >= 0)
+            continue;
+        makeProjections(model);
+        model->getPrintName();
+        fitList[fitCount++] = model;
     }
+    std::sort(fitList, fitList + fitCount);
+    fitCount = std::unique(fitList, fitList + fitCount) - fitList;
 
-    // Do all of the work of figuring out the intersects.
-    // Then we'll do a pass over the work array to
-    // represent the intersects in a more compressed way.
-    // Much of the work in the below section can probably be elided.
-    int levelstart = 0;
-    int levelend = fitIntersectCount;
-    int level0end = fitIntersectCount;
-    bool sign = true;
-    int *newvars, newcount;
+    //-- with one thread there is nothing to gain; leave the fits to the statistics calls
+    int threadCount = ocThreadCount((int) threadOption, fitCount);
+    if (threadCount <= 1) {
+        delete[] fitList;
+        return;
+    }
+    if (threadCount > threadWorkCount) {
+        FitWorkspace **pool = new FitWorkspace*[threadCount];
+        for (int t = 0; t < threadCount; t++) {
+            pool[t] = t < threadWorkCount ? threadWork[t] : new FitWorkspace;
+        }
+        if (threadWork) delete[] threadWork;
+        threadWork = pool;
+        threadWorkCount = threadCount;
+    }
+
+    //-- each thread takes the next unfitted model, so uneven fit times balance out.
+    //-- The IPF inside each fit runs on one thread.
+    std::atomic<long> next(0);
+    ocRunThreads(threadCount, [&](int t) {
+        FitWorkspace &work = *threadWork[t];
+        long i;
+        while ((i = next++) < fitCount) {
+            Model *model = fitList[i];
+            if (!fitIPF(model, work, 1))
+                continue;
+            double h = ocEntropy(work.fitTable1);
+            model->setAttribute(ATTRIBUTE_FIT_H, h);
+            model->setAttribute(ATTRIBUTE_H, h);
+            keepFit(model, work.fitTable1);
+        }
+    });
+    updateWorkspacePeak();
+    delete[] fitList;
+}
 
-    while (levelend > levelstart) {
-        sign = !sign;
-        for (int i = levelstart; i < levelend; i++) {
-            for (int j = fitIntersectArray[i].startIndex + 1; j < level0end; j++) {
-                VarIntersect* ip = fitIntersectArray + i;
-                VarIntersect* jp = fitIntersectArray + j;
-
-                if (intersect(ip->rel, jp->rel, newvars, newcount)) {
-
-                    Relation* rel = getRelation(newvars, newcount, true);
-                    //-- add this intersection term to the DF, and append to list
-                    while (fitIntersectCount >= fitIntersectMax) {
-                        fitIntersectArray =
-                                (VarIntersect*) growStorage(fitIntersectArray, sizeof(VarIntersect)*fitIntersectMax, 2);
-                        fitIntersectMax *= 2;
-                    }
-                    VarIntersect* newp = fitIntersectArray + (fitIntersectCount++);
-                    newp->rel = rel;
-                    newp->startIndex = j;
-                    newp->sign = sign;
-                    delete[] newvars;
-                }
-            }
+//-- sums the signed count of each intersection term, for the algebraic fit
+struct FitIntersectProc: public ocIntersectProcessor {
+        FitIntersectMap &out;
+        FitIntersectProc(FitIntersectMap &map) :
+                out(map) {
         }
-        levelstart = levelend;
-        levelend = fitIntersectCount;
-    }
+        void process(bool sign, Relation *rel, int count) {
+            // NOTE: C++ std::map has the following behavior for operator[]:
+            // when the key does not yet exist, a new element is inserted using the default constructor -- 0, in the case of `long long`.
+            out[rel] += (sign ? 1 : -1) * (long long) count;
+        }
+};
 
-    // Allocate the map of intersect levels,
-    //  which is what is actually of interest
+FitIntersectMap ManagerBase::computeIntersectLevels(Model* model) {
+    // The map of intersect levels: for each intersection term of the model,
+    // the number of times it is added, less the number of times it is subtracted.
     FitIntersectMap out;
-    // Iterate over the work array and add everything to the map.
-    for(long long ri = 0; ri < fitIntersectCount; ++ri) {
-        VarIntersect fi = fitIntersectArray[ri];
-    
-        // NOTE: C++ std::map has the following behavior for operator[]:
-        // when the key does not yet exist, a new element is inserted using the default constructor -- 0, in the case of `long long`.
-        out[fi.rel] += fi.sign ? 1 : -1;
-    }
-
-    delete[] fitIntersectArray;
+    FitIntersectProc processor(out);
+    doIntersectionProcessing(model, &processor);
     return out;
 }
 
@@ -113,6 +113,22 @@ bool ManagerBase::initFromCommandLine(int argc, char **argv) {
         currentOptDef = options->findOptionByName("ipf-maxit");
         setOptionFloat(currentOptDef, 266);
     }
+    if (!getOptionFloat("ipf-threads", NULL, &value)) {
+        currentOptDef = options->findOptionByName("ipf-threads");
+        setOptionFloat(currentOptDef, 1);
+    }
+    if (!getOptionFloat("ipf-accel", NULL, &value)) {
+        currentOptDef = options->findOptionByName("ipf-accel");
+        setOptionFloat(currentOptDef, 0);
+    }
+    if (!getOptionFloat("ipf-warm-start", NULL, &value)) {
+        currentOptDef = options->findOptionByName("ipf-warm-start");
+        setOptionFloat(currentOptDef, 0);
+    }
+    if (!getOptionFloat("search-threads", NULL, &value)) {
+        currentOptDef = options->findOptionByName("search-threads");
+        setOptionFloat(currentOptDef, 1);
+    }
 
     inputData = input;
     testData = test;
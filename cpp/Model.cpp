@@ -39,6 +39,7 @@ Model::Model(int size) {
     attributeList = new AttributeList(6);
     printName = NULL;
     inverseName = NULL;
+    hasFingerprint = false;
     hashNext = NULL;
     progenitor = NULL;
     ID = 0;
@@ -106,6 +107,49 @@ void Model::copyRelations(Model &model, int skip1, int skip2) {
     }
 }
 
+ModelFingerprint Model::getFingerprint() {
+    if (!hasFingerprint) {
+        print = fingerprint(relations, relationCount);
+        hasFingerprint = true;
+    }
+    return print;
+}
+
+ModelFingerprint Model::fingerprint(Relation **rels, int count) {
+    ModelFingerprint sum = { 0, 0 };
+    for (int i = 0; i < count; i++) {
+        const unsigned long long *relPrint = rels[i]->getFingerprint();
+        sum.a += relPrint[0];
+        sum.b += relPrint[1];
+    }
+    return sum;
+}
+
+//-- this follows addRelation: state-based relations are only dropped if they are
+//-- duplicates, since their containment depends on the model (see containsRelation).
+int Model::normalizeRelations(Relation **rels, int count) {
+    bool *drop = new bool[count];
+    for (int i = 0; i < count; i++) {
+        Relation *rel = rels[i];
+        drop[i] = false;
+        for (int j = 0; j < count && !drop[i]; j++) {
+            if (j == i)
+                continue;
+            if (rels[j] == rel)
+                drop[i] = j < i;
+            else if (!rel->isStateBased() && !rels[j]->isStateBased() && rels[j]->contains(rel))
+                drop[i] = true;
+        }
+    }
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (!drop[i])
+            rels[kept++] = rels[i];
+    }
+    delete[] drop;
+    return kept;
+}
+
 void Model::setAttribute(const char *name, double value) {
     attributeList->setAttribute(name, value);
 }
@@ -313,6 +357,7 @@ void Model::addRelation(Relation *newRelation, bool normalize, ModelCache *cache
     }
     relations[i] = newRelation;
     relationCount++;
+    hasFingerprint = false;
     if (printName) {
         delete printName;
         printName = NULL;
@@ -13,56 +13,79 @@
 #include <memory.h>
 #include <string.h>
 
-static int hashcode(const char *name, int hashsize) {
-    unsigned int key = 0;
-    for (const char *cp = name; *cp; cp++)
-        key = (key << 1) + *cp;
-    return key % hashsize;
-}
+#define PRINT_START_SLOTS 32
+
+//-- marks a slot whose model was deleted; probes continue past it
+static Model *const TOMBSTONE = (Model *) 1;
 
 ModelCache::ModelCache() {
-    hash = new Model*[MODELCACHE_HASHSIZE];
-    memset(hash, 0, MODELCACHE_HASHSIZE * sizeof(Model*));
+    for (int s = 0; s < NAMECACHE_SHARDS; s++) {
+        PrintShard &shard = printShards[s];
+        shard.slots = new Model*[PRINT_START_SLOTS];
+        shard.codes = new unsigned long long[PRINT_START_SLOTS];
+        memset(shard.slots, 0, PRINT_START_SLOTS * sizeof(Model*));
+        shard.slotCount = PRINT_START_SLOTS;
+        shard.itemCount = 0;
+        shard.usedCount = 0;
+    }
 }
 
 //-- destroy Model cache.  This also deletes all the Models held in the cache.
 ModelCache::~ModelCache() {
-    Model *r1, *r2;
-    int i;
-    for (i = 0; i < MODELCACHE_HASHSIZE; i++) {
-        r1 = hash[i];
-        while (r1) {
-            r2 = r1->getHashNext();
-            delete r1;
-            r1 = r2;
-        }
+    hash.forEach([](Model *model) { delete model; });
+    for (int s = 0; s < NAMECACHE_SHARDS; s++) {
+        delete[] printShards[s].slots;
+        delete[] printShards[s].codes;
     }
-    delete hash;
 }
 
 long ModelCache::size() {
-    long size = MODELCACHE_HASHSIZE * sizeof(Model*);
-    Model *r1;
-    int i;
-    for (i = 0; i < MODELCACHE_HASHSIZE; i++) {
-        r1 = hash[i];
-        while (r1) {
-            size += r1->size();
-            r1 = r1->getHashNext();
-        }
+    long size = hash.size();
+    for (int s = 0; s < NAMECACHE_SHARDS; s++) {
+        size += printShards[s].slotCount * (sizeof(Model*) + sizeof(unsigned long long));
     }
+    hash.forEach([&](Model *model) { size += model->size(); });
     return size;
 }
 
 //-- addModel - put a new Model in the cache. If a matching Model already
 //-- exists, an error is returned.
 bool ModelCache::addModel(class Model *model) {
-    if (findModel(model->getPrintName()) != NULL)
-        return false; //error; exists
-    int hashindex = hashcode(model->getPrintName(), MODELCACHE_HASHSIZE);
-    model->setHashNext(hash[hashindex]);
-    hash[hashindex] = model;
-    return true;
+    return findOrAddModel(model) == model;
+}
+
+//-- findOrAddModel - add a Model unless a matching one is already cached.
+//-- Returns the cached Model.
+class Model *ModelCache::findOrAddModel(class Model *model) {
+    //-- the fingerprint is built on first use; build it while model is still private
+    model->getFingerprint();
+    Model *cached = hash.findOrAdd(model);
+    if (cached == model)
+        addPrint(model);
+    return cached;
+}
+
+//-- findOrAddModel - get the Model with these relations, building it only if the
+//-- fingerprint index doesn't have it.
+class Model *ModelCache::findOrAddModel(class Relation **rels, int count, bool *fromCache) {
+    count = Model::normalizeRelations(rels, count);
+    Model *model = findModel(rels, count);
+    bool cached = model != NULL;
+    if (model == NULL) {
+        Model *newModel = new Model(count > 0 ? count : 1);
+        for (int i = 0; i < count; i++) {
+            newModel->addRelation(rels[i], false);
+        }
+        model = findOrAddModel(newModel);
+        if (model != newModel) {
+            //-- another thread added it since the probe
+            delete newModel;
+            cached = true;
+        }
+    }
+    if (fromCache)
+        *fromCache = cached;
+    return model;
 }
 
 //-- deleteModel - deletes a model from the cache.
@@ -70,47 +93,110 @@ bool ModelCache::addModel(class Model *model) {
 bool ModelCache::deleteModel(class Model *model) {
     if (model == NULL)
         return false;
-    int hashindex = hashcode(model->getPrintName(), MODELCACHE_HASHSIZE);
-    Model *rp = hash[hashindex];
-    Model *prev = NULL;
-    while (rp && (rp != model)) {
-        prev = rp;
-        rp = rp->getHashNext();
-    }
-    if (rp != NULL) {
-        if (rp == hash[hashindex]) {
-            hash[hashindex] = rp->getHashNext();
-        } else {
-            prev->setHashNext(rp->getHashNext());
-        }
-        //		printf("deleting: %s\n", model->getPrintName());
-        delete rp;
-        return true;
-    } else {
+    if (!hash.remove(model))
         return false;
-    }
+    removePrint(model);
+    //		printf("deleting: %s\n", model->getPrintName());
+    delete model;
+    return true;
 }
 
 //-- findModel - find a Model in the cache.  Null is returned if the given
 //-- Model doesn't exist.
 class Model *ModelCache::findModel(const char *name) {
-    int hashindex = hashcode(name, MODELCACHE_HASHSIZE);
-    Model *rp = hash[hashindex];
-    while (rp && strcmp(name, rp->getPrintName()) != 0)
-        rp = rp->getHashNext();
-    return rp; // either NULL, or the matching one
+    return hash.find(name);
 }
 
-//-- dump - print out all Models in the cache
-void ModelCache::dump() {
-    printf("\nDump ModelCache:\n");
-    for (int i = 0; i < MODELCACHE_HASHSIZE; i++) {
-        if (hash[i]) {
-            printf("hash chain [%d]:\n", i);
-            for (Model *model = hash[i]; model; model = model->getHashNext()) {
-                model->dump();
+//-- findModel - find a Model by the fingerprint of its (normalized) relations.
+//-- A fingerprint match is confirmed by comparing the relations themselves, which
+//-- are unique in the relation cache, so pointers can be compared.
+class Model *ModelCache::findModel(class Relation **rels, int count) {
+    ModelFingerprint print = Model::fingerprint(rels, count);
+    PrintShard &shard = printShards[print.a >> 58];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    long last = shard.slotCount - 1;
+    for (long i = print.a & last; shard.slots[i]; i = (i + 1) & last) {
+        Model *model = shard.slots[i];
+        if (model == TOMBSTONE || shard.codes[i] != print.a)
+            continue;
+        if (model->getFingerprint().b != print.b || model->getRelationCount() != count)
+            continue;
+        int r;
+        for (r = 0; r < count; r++) {
+            int m;
+            for (m = 0; m < count; m++) {
+                if (model->getRelation(m) == rels[r])
+                    break;
             }
+            if (m == count)
+                break;
+        }
+        if (r == count)
+            return model;
+    }
+    return NULL;
+}
+
+//-- add a newly cached Model to the fingerprint index. The slot arrays are kept
+//-- at most half full, counting tombstones.
+void ModelCache::addPrint(class Model *model) {
+    unsigned long long code = model->getFingerprint().a;
+    PrintShard &shard = printShards[code >> 58];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    if (2 * (shard.usedCount + 1) > shard.slotCount) {
+        //-- double if the live models need it, otherwise just clear the tombstones
+        long newCount = shard.slotCount;
+        if (4 * (shard.itemCount + 1) > shard.slotCount)
+            newCount *= 2;
+        rebuildPrints(shard, newCount);
+    }
+    long last = shard.slotCount - 1;
+    long i = code & last;
+    while (shard.slots[i])
+        i = (i + 1) & last;
+    shard.slots[i] = model;
+    shard.codes[i] = code;
+    shard.itemCount++;
+    shard.usedCount++;
+}
+
+void ModelCache::removePrint(class Model *model) {
+    unsigned long long code = model->getFingerprint().a;
+    PrintShard &shard = printShards[code >> 58];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    long last = shard.slotCount - 1;
+    for (long i = code & last; shard.slots[i]; i = (i + 1) & last) {
+        if (shard.slots[i] == model) {
+            shard.slots[i] = TOMBSTONE;
+            shard.itemCount--;
+            return;
         }
     }
 }
 
+void ModelCache::rebuildPrints(PrintShard &shard, long newCount) {
+    Model **slots = new Model*[newCount];
+    unsigned long long *codes = new unsigned long long[newCount];
+    memset(slots, 0, newCount * sizeof(Model*));
+    for (long j = 0; j < shard.slotCount; j++) {
+        if (shard.slots[j] == NULL || shard.slots[j] == TOMBSTONE)
+            continue;
+        long i = shard.codes[j] & (newCount - 1);
+        while (slots[i])
+            i = (i + 1) & (newCount - 1);
+        slots[i] = shard.slots[j];
+        codes[i] = shard.codes[j];
+    }
+    delete[] shard.slots;
+    delete[] shard.codes;
+    shard.slots = slots;
+    shard.codes = codes;
+    shard.slotCount = newCount;
+    shard.usedCount = shard.itemCount;
+}
+
+//-- dump - print out all Models in the cache
+void ModelCache::dump() {
+    printf("\nDump ModelCache (%ld models):\n", hash.count());
+    hash.forEach([](Model *model) { model->dump(); });
+}
@@ -20,9 +20,11 @@
 double ocEntropy(Table *p) {
     double h = 0.0;
     long long count = p->getTupleCount();
+    const ocTupleValue *values = p->getValueArray();
+    long long stride = p->getValueStride();
     double pv;
     for (long long i = 0; i < count; ++i) {
-        pv = p->getValue(i);
+        pv = values[i * stride];
         if (pv > PROB_MIN)
             h -= pv * log(pv);
     }
@@ -138,60 +140,6 @@ bool ocHasOverlaps(Model *model) {
     return false;
 }
 
-//-- these definitions are used in loop checking
-struct VarList {
-        int varCount;
-        int *vars;
-        VarList() :
-                varCount(0), vars(0) {
-        }
-        ~VarList() {
-            if (vars)
-                delete[] vars;
-        }
-        void setVars(int *newVars) {
-            if (vars)
-                delete[] vars;
-            vars = newVars;
-        }
-};
-
-//-- copy a VarList
-static void VLCopy(VarList &from, VarList &to) {
-    if (to.varCount < from.varCount) {
-        to.setVars(new int[from.varCount]);
-    }
-    to.varCount = from.varCount;
-    if (to.varCount > 0)
-        memcpy(to.vars, from.vars, to.varCount * sizeof(int));
-}
-
-//-- remove variables from v1 which are present in v2
-static void VLComplement(VarList &v1, VarList &v2) {
-    if (v1.varCount == 0 || v1.varCount == 0)
-        return;
-    int *newvars = new int[v1.varCount];
-    int count = 0, i, j;
-    for (i = 0; i < v1.varCount; i++) {
-        for (j = 0; j < v2.varCount; j++) {
-            if (v2.vars[j] == v1.vars[i])
-                break;
-        }
-        if (j >= v2.varCount) { // not found; add it to result
-            newvars[count++] = v1.vars[i];
-        }
-    }
-    v1.setVars(newvars);
-    v1.varCount = count;
-}
-
-//-- check for containment (v1 contains v2)
-static bool VLContains(VarList &v1, VarList &v2) {
-    if (v1.varCount < v2.varCount)
-        return false; // quick check for impossibility
-    return ocContainsVariables(v1.varCount, v1.vars, v2.varCount, v2.vars);
-}
-
 // returns true if first boolean array is a superset of (or equal to) second
 bool isSuperset(bool *first, bool *second, int length) {
     for (int i = 0; i < length; i++)
@@ -348,52 +296,80 @@ bool ocHasLoops(Model *model) {
     }
     if (model->isStateBased())
         return ocSbHasLoops(model);
+    //-- GYO reduction: repeatedly drop variables which occur in only one relation,
+    //-- and relations which are empty or contained in another. The model has loops
+    //-- if more than one relation survives. Rather than sweeping all relations until
+    //-- nothing changes, keep per-variable occurrence counts and a worklist of
+    //-- relations which have changed (or whose variables have become unique).
     int i, j, relcount;
     relcount = model->getRelationCount();
-    VarList *rels = new VarList[relcount];
-    //-- copy variable lists from relations
+    VarSet *rels = new VarSet[relcount];
+    bool *live = new bool[relcount];
+    bool *dirty = new bool[relcount];
+    int *work = new int[relcount];
+    int workCount = 0;
+    int varCount = 0;
     for (i = 0; i < relcount; i++) {
         Relation *relation = model->getRelation(i);
-        rels[i].varCount = relation->getVariableCount();
-        rels[i].setVars(new int[rels[i].varCount]);
-        relation->copyVariables(rels[i].vars, rels[i].varCount);
+        rels[i] = relation->getVarSet();
+        int *vars = relation->getVariables();
+        for (j = 0; j < relation->getVariableCount(); j++) {
+            if (vars[j] >= varCount)
+                varCount = vars[j] + 1;
+        }
+        live[i] = true;
+        dirty[i] = true;
+        work[workCount++] = i;
+    }
+    int *occurs = new int[varCount > 0 ? varCount : 1];
+    memset(occurs, 0, varCount * sizeof(int));
+    for (i = 0; i < relcount; i++) {
+        for (int v = rels[i].next(0); v >= 0; v = rels[i].next(v + 1))
+            occurs[v]++;
     }
 
-    for (;;) {
-        bool change = false;
-        //-- repeat until no further change:
-        //-- first eliminate variables occuring in only one relation.
-        //-- then eliminate relations which are subsets of others
-        for (i = 0; i < relcount; i++) {
-            VarList newList;
-            VLCopy(rels[i], newList);
-            for (j = 0; j < relcount; j++) {
-                if (j != i)
-                    VLComplement(newList, rels[j]);
-            }
-            if (newList.varCount > 0) {
-                VLComplement(rels[i], newList);
-                change = true;
+    int remaining = relcount;
+    while (workCount > 0) {
+        i = work[--workCount];
+        dirty[i] = false;
+        if (!live[i])
+            continue;
+        //-- drop the variables which no other relation has
+        for (int v = rels[i].next(0); v >= 0; v = rels[i].next(v + 1)) {
+            if (occurs[v] == 1) {
+                rels[i].remove(v);
+                occurs[v] = 0;
             }
         }
-        for (i = 0; i < relcount; i++) {
+        //-- drop the relation if it is now empty or a subset of another
+        bool drop = rels[i].isEmpty();
+        for (j = 0; !drop && j < relcount; j++) {
+            drop = j != i && live[j] && rels[j].contains(rels[i]);
+        }
+        if (!drop)
+            continue;
+        live[i] = false;
+        remaining--;
+        //-- a variable left in only one relation makes that relation reducible again
+        for (int v = rels[i].next(0); v >= 0; v = rels[i].next(v + 1)) {
+            if (--occurs[v] != 1)
+                continue;
             for (j = 0; j < relcount; j++) {
-                if (i != j && rels[i].varCount > 0 && rels[j].varCount > 0 && VLContains(rels[i], rels[j])) {
-                    change = true;
-                    rels[j].varCount = 0;
+                if (live[j] && rels[j].has(v)) {
+                    if (!dirty[j]) {
+                        dirty[j] = true;
+                        work[workCount++] = j;
+                    }
+                    break;
                 }
             }
         }
-        if (!change)
-            break;
     }
 
-    //-- do cleanup, and also see if there are any relations left.
-    int remaining = 0;
-    for (i = 0; i < relcount; i++) {
-        if (rels[i].varCount > 0)
-            remaining++;
-    }
+    delete[] occurs;
+    delete[] work;
+    delete[] dirty;
+    delete[] live;
     delete[] rels;
     return remaining > 1;
 }
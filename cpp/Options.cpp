@@ -112,6 +112,8 @@ static void setStandardOptions(Options *opts) {
     opts->addOptionValue(def, "#", "");
     def = opts->addOptionName("search-levels", "L", "Max levels to search (search), default=all");
     opts->addOptionValue(def, "#", "");
+    def = opts->addOptionName("checkpoint-file", "", "Save search state after each level, and resume from it (search)");
+    opts->addOptionValue(def, "$", "file name");
     def = opts->addOptionName("short-model", "m", "A model (colon delimited relation list using abbreviations)");
     opts->addOptionValue(def, "$", "e.g., AB:BC:D, NULL, SAT");
     def = opts->addOptionName("long-model", "M", "A model (colon delimited relation list using names)");
@@ -141,6 +143,20 @@ static void setStandardOptions(Options *opts) {
     opts->addOptionValue(def, "#", "");
     def = opts->addOptionName("ipf-maxdev", "i", "Max error in IPF, default=0.25");
     opts->addOptionValue(def, "#", "");
+    def = opts->addOptionName("data-cache-file", "", "Save the data, once read, as a binary file which loads faster");
+    opts->addOptionValue(def, "$", "file name");
+    def = opts->addOptionName("read-memory", "", "Memory for summing the data, in MB (0 = no limit; beyond it, sorted runs go to temporary files; reading in parallel takes up to as much again), default=0");
+    opts->addOptionValue(def, "#", "");
+    def = opts->addOptionName("read-threads", "", "Threads for reading the data (0 = one per core), default=0");
+    opts->addOptionValue(def, "#", "");
+    def = opts->addOptionName("ipf-threads", "", "Threads for IPF fitting (0 = one per core), default=1");
+    opts->addOptionValue(def, "#", "");
+    def = opts->addOptionName("ipf-accel", "", "Extrapolate IPF steps to converge faster (1 = on; results may shift within ipf-maxdev), default=0");
+    opts->addOptionValue(def, "#", "");
+    def = opts->addOptionName("ipf-warm-start", "", "Start IPF from the progenitor model's fit (1 = on; results may shift within ipf-maxdev), default=0");
+    opts->addOptionValue(def, "#", "");
+    def = opts->addOptionName("search-threads", "", "Threads for fitting the models of a search level (0 = one per core), default=1");
+    opts->addOptionValue(def, "#", "");
     def = opts->addOptionName("no-frequency", "", "There is no frequency data in table");
     def = opts->addOptionName("function-values", "", "Values represent function data, not frequencies.");
     opts->addOptionValue(def, "$", "");
@@ -0,0 +1,53 @@
+/*
+ * Copyright © 1990 The Portland State University OCCAM Project Team
+ * [This program is licensed under the GPL version 3 or later.]
+ * Please see the file LICENSE in the source
+ * distribution of this software for license terms.
+ */
+
+#include "Parallel.h"
+#include <thread>
+#include <vector>
+
+
+Barrier::Barrier(int threads) :
+        threadCount(threads), waiting(0), generation(0) {
+}
+
+
+void Barrier::wait() {
+    std::unique_lock<std::mutex> guard(lock);
+    long arrivedIn = generation;
+    if (++waiting == threadCount) {
+        waiting = 0;
+        generation++;
+        released.notify_all();
+    } else {
+        released.wait(guard, [&] { return generation != arrivedIn; });
+    }
+}
+
+
+int ocThreadCount(int requested, long long work, long long minWork) {
+    int threads = requested;
+    if (threads <= 0) {
+        threads = std::thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+    }
+    if (work > 0 && minWork > 0 && threads > work / minWork) {
+        threads = work / minWork;
+    }
+    return threads < 1 ? 1 : threads;
+}
+
+
+void ocRunThreads(int threadCount, const std::function<void(int)> &body) {
+    std::vector<std::thread> threads;
+    for (int t = 1; t < threadCount; t++) {
+        threads.push_back(std::thread(body, t));
+    }
+    body(0);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
@@ -14,93 +14,136 @@
 #include <memory.h>
 #include <string.h>
 
-static int hashcode(const char *name, int hashsize) {
-    unsigned int key = 0;
-    for (const char *cp = name; *cp; cp++)
-        key = (key << 1) + *cp;
-    return key % hashsize;
+#define MASK_START_SLOTS 32
+
+static unsigned long long maskCode(const KeySegment *mask, int keysize) {
+    unsigned long long code = 14695981039346656037ULL;
+    for (int i = 0; i < keysize; i++) {
+        code = (code ^ mask[i]) * 1099511628211ULL;
+        code ^= code >> 29;
+    }
+    return code;
 }
 
 RelCache::RelCache() {
-    hash = new Relation*[RELCACHE_HASHSIZE];
-    memset(hash, 0, RELCACHE_HASHSIZE * sizeof(Relation*));
+    for (int s = 0; s < NAMECACHE_SHARDS; s++) {
+        MaskShard &shard = maskShards[s];
+        shard.slots = new Relation*[MASK_START_SLOTS];
+        shard.codes = new unsigned long long[MASK_START_SLOTS];
+        memset(shard.slots, 0, MASK_START_SLOTS * sizeof(Relation*));
+        shard.slotCount = MASK_START_SLOTS;
+        shard.itemCount = 0;
+    }
 }
 
 //-- destroy relation cache.  This also deletes all the relations held in the cache.
 RelCache::~RelCache() {
-    Relation *r1, *r2;
-    int i;
-    for (i = 0; i < RELCACHE_HASHSIZE; i++) {
-        r1 = hash[i];
-        while (r1) {
-            r2 = r1->getHashNext();
-            delete r1;
-            r1 = r2;
-        }
+    hash.forEach([](Relation *rel) { delete rel; });
+    for (int s = 0; s < NAMECACHE_SHARDS; s++) {
+        delete[] maskShards[s].slots;
+        delete[] maskShards[s].codes;
     }
-    delete hash;
 }
 
 long RelCache::size() {
-    long size = RELCACHE_HASHSIZE * sizeof(Relation*);
-    Relation *r1;
-    int i;
-    for (i = 0; i < RELCACHE_HASHSIZE; i++) {
-        r1 = hash[i];
-        while (r1) {
-            size += r1->size();
-            r1 = r1->getHashNext();
-        }
+    long size = hash.size();
+    for (int s = 0; s < NAMECACHE_SHARDS; s++) {
+        size += maskShards[s].slotCount * (sizeof(Relation*) + sizeof(unsigned long long));
     }
+    hash.forEach([&](Relation *rel) { size += rel->size(); });
     return size;
 }
 
 //-- delete tables from all relations
-void RelCache::deleteTables() {
-    Relation *r1;
-    int i;
-    for (i = 0; i < RELCACHE_HASHSIZE; i++) {
-        r1 = hash[i];
-        while (r1) {
-            r1->deleteTable();
-            r1 = r1->getHashNext();
-        }
-    }
+void RelCache::deleteTables(Table *keep) {
+    hash.forEach([keep](Relation *rel) {
+        if (rel->getTable() != keep)
+            rel->deleteTable();
+    });
 }
 
 //-- addRelation - put a new relation in the cache. If a matching relation already
 //-- exists, an error is returned.
-// [JSF] This doesn't seem to check for matches, or return errors.
 bool RelCache::addRelation(class Relation *rel) {
-    if (findRelation(rel->getPrintName()) != NULL)
-        return false; //error; exists
-    KeySegment *mask = rel->getMask();
-    int hashindex = hashcode(rel->getPrintName(), RELCACHE_HASHSIZE);
-    rel->setHashNext(hash[hashindex]);
-    hash[hashindex] = rel;
-    return true;
+    return findOrAddRelation(rel) == rel;
+}
+
+//-- findOrAddRelation - add a relation unless a matching one is already cached.
+//-- Returns the cached relation.
+class Relation *RelCache::findOrAddRelation(class Relation *rel) {
+    //-- the mask, variable set and fingerprint are built on first use; build them
+    //-- while rel is still private
+    if (!rel->isStateBased())
+        rel->getMask();
+    rel->getVarSet();
+    rel->getFingerprint();
+    Relation *cached = hash.findOrAdd(rel);
+    if (cached == rel && !rel->isStateBased())
+        addMask(rel);
+    return cached;
 }
 
 //-- findRelation - find a relation in the cache.  Null is returned if the given
 //-- relation doesn't exist.
 class Relation *RelCache::findRelation(const char *name) {
-    int hashindex = hashcode(name, RELCACHE_HASHSIZE);
-    Relation *rp = hash[hashindex];
-    while (rp && strcmp(name, rp->getPrintName()) != 0)
-        rp = rp->getHashNext();
-    return rp; // either NULL, or the matching one
+    return hash.find(name);
 }
 
-//-- dump - print out all relations in the cache
-void RelCache::dump() {
-    printf("\nDumping RelCache:\n");
-    for (int i = 0; i < RELCACHE_HASHSIZE; i++) {
-        if (hash[i]) {
-            printf("hash chain [%d]:\n", i);
-            for (Relation *rel = hash[i]; rel; rel = rel->getHashNext()) {
-                rel->dump();
-            }
-        }
+//-- findRelation - find a variable-based relation by its mask.
+class Relation *RelCache::findRelation(const KeySegment *mask, int keysize) {
+    unsigned long long code = maskCode(mask, keysize);
+    MaskShard &shard = maskShards[code >> 58];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    long last = shard.slotCount - 1;
+    for (long i = code & last; shard.slots[i]; i = (i + 1) & last) {
+        if (shard.codes[i] == code
+                && memcmp(shard.slots[i]->getMask(), mask, keysize * sizeof(KeySegment)) == 0)
+            return shard.slots[i];
     }
+    return NULL;
 }
 
+//-- add a newly cached relation to the mask index. The slot arrays are kept
+//-- at most half full.
+void RelCache::addMask(class Relation *rel) {
+    KeySegment *mask = rel->getMask();
+    unsigned long long code = maskCode(mask, rel->getKeySize());
+    MaskShard &shard = maskShards[code >> 58];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    if (2 * (shard.itemCount + 1) > shard.slotCount)
+        growMasks(shard);
+    long last = shard.slotCount - 1;
+    long i = code & last;
+    while (shard.slots[i])
+        i = (i + 1) & last;
+    shard.slots[i] = rel;
+    shard.codes[i] = code;
+    shard.itemCount++;
+}
+
+void RelCache::growMasks(MaskShard &shard) {
+    long newCount = shard.slotCount * 2;
+    Relation **slots = new Relation*[newCount];
+    unsigned long long *codes = new unsigned long long[newCount];
+    memset(slots, 0, newCount * sizeof(Relation*));
+    for (long j = 0; j < shard.slotCount; j++) {
+        if (shard.slots[j] == NULL)
+            continue;
+        long i = shard.codes[j] & (newCount - 1);
+        while (slots[i])
+            i = (i + 1) & (newCount - 1);
+        slots[i] = shard.slots[j];
+        codes[i] = shard.codes[j];
+    }
+    delete[] shard.slots;
+    delete[] shard.codes;
+    shard.slots = slots;
+    shard.codes = codes;
+    shard.slotCount = newCount;
+}
+
+//-- dump - print out all relations in the cache
+void RelCache::dump() {
+    printf("\nDumping RelCache (%ld relations):\n", hash.count());
+    hash.forEach([](Relation *rel) { rel->dump(); });
+}
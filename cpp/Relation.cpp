@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 
 Relation::Relation(VariableList *list, int size, int keysz, long stateconstsz) {
     varList = list;
@@ -30,6 +31,8 @@ Relation::Relation(VariableList *list, int size, int keysz, long stateconstsz) {
         stateConstraints = new StateConstraint(keysz, stateconstsz);
     }
     mask = NULL;
+    varSet = NULL;
+    hasFingerprint = false;
     hashNext = NULL;
     attributeList = new AttributeList(2);
     printName = NULL;
@@ -54,6 +57,8 @@ Relation::~Relation() {
         delete table;
     if (mask)
         delete[] mask;
+    if (varSet)
+        delete varSet;
 }
 
 long Relation::size() {
@@ -83,6 +88,11 @@ void Relation::addVariable(int varindex, int stateind) {
         maxVarCount *= FACTOR;
     }
     vars[varCount] = varindex;
+    if (varSet) {
+        //-- rebuilt on next use, in case it needs more room
+        delete varSet;
+        varSet = NULL;
+    }
     if (stateind >= 0 || stateind == DONT_CARE) {
         states[varCount] = stateind;
     }
@@ -260,7 +270,7 @@ bool Relation::contains(Relation *other) {
         return ocContainsStates(varCount, vars, states, other->varCount, other->vars, other->states);
         // or check if models of rel A & B are equivalent
     else
-        return ocContainsVariables(varCount, vars, other->varCount, other->vars);
+        return getVarSet().contains(other->getVarSet());
 }
 
 // see if all variables are independent variables. These relations are not decomposed during search
@@ -316,21 +326,16 @@ KeySegment *Relation::getMask() {
     return mask;
 }
 
-static int sortCompare(const void *k1, const void *k2) {
-    return *((int*) k1) - *((int*) k2);
-}
-
-static int *sorting_vars;
-//static int sbSortCompare(void *thunk, const void *k1, const void *k2) {
-static int sbSortCompare(const void *k1, const void *k2) {
-    //int* vars = (int *) thunk;
-    return sorting_vars[*((int *) k1)] - sorting_vars[*((int *) k2)];
+const unsigned long long *Relation::getFingerprint() {
+    if (!hasFingerprint)
+        buildFingerprint();
+    return fingerprint;
 }
 
 void Relation::sort(int *vars, int varCount, int *states) {
     if (varCount <= 1) return;
     if (states == NULL) {
-        qsort(vars, varCount, sizeof(int), sortCompare);
+        std::sort(vars, vars + varCount);
     } else {
         // when there are states, we must arrange both lists in unison, by the vars values.
         // we do this by sorting an index list based on the vars values, and then arranging
@@ -338,10 +343,7 @@ void Relation::sort(int *vars, int varCount, int *states) {
         int* order = new int[varCount];
         for (int i = 0; i < varCount; i++)
             order[i] = i;
-        // order of args must be changed for qsort_r, and its compare function, from BSD to GNU.
-        // last 2 args of qsort_r must be switched, and the thunk moved to the end of compare.
-        sorting_vars = vars;
-        qsort(order, varCount, sizeof(int), sbSortCompare);
+        std::stable_sort(order, order + varCount, [vars](int a, int b) { return vars[a] < vars[b]; });
         int *vars_copy = new int[varCount];
         int *states_copy = new int[varCount];
         memcpy(vars_copy, vars, varCount * sizeof(int));
@@ -358,7 +360,6 @@ void Relation::sort(int *vars, int varCount, int *states) {
 
 void Relation::sort() {
     sort(vars, varCount, states);
-    //qsort(vars, varCount, sizeof(int), sortCompare);
 }
 
 void Relation::setAttribute(const char *name, double value) {
@@ -464,6 +465,54 @@ void Relation::buildMask() {
     Key::buildMask(mask, keysize, varList, vars, varCount);
 }
 
+void Relation::buildVarSet() {
+    int size = varList ? varList->getVarCount() : 0;
+    for (int i = 0; i < varCount; i++) {
+        if (vars[i] >= size)
+            size = vars[i] + 1;
+    }
+    varSet = new VarSet(size);
+    for (int i = 0; i < varCount; i++) {
+        varSet->add(vars[i]);
+    }
+}
+
+//-- finish one lane of the fingerprint (the splitmix64 finalizer), so that models
+//-- can combine relation fingerprints by simple addition
+static unsigned long long mixFingerprint(unsigned long long h) {
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+//-- variable-based relations hash their masks; state-based ones their print names,
+//-- which also carry the states.
+void Relation::buildFingerprint() {
+    unsigned long long a = 14695981039346656037ULL;
+    unsigned long long b = 0x9e3779b97f4a7c15ULL;
+    if (isStateBased()) {
+        for (const char *cp = getPrintName(); *cp; cp++) {
+            a = (a ^ (unsigned char) *cp) * 1099511628211ULL;
+            b = (b + (unsigned char) *cp) * 0xff51afd7ed558ccdULL;
+        }
+    } else {
+        KeySegment *msk = getMask();
+        int keysize = varList->getKeySize();
+        for (int i = 0; i < keysize; i++) {
+            a = (a ^ msk[i]) * 1099511628211ULL;
+            a ^= a >> 29;
+            b = (b + msk[i]) * 0xff51afd7ed558ccdULL;
+            b ^= b >> 33;
+        }
+    }
+    fingerprint[0] = mixFingerprint(a);
+    fingerprint[1] = mixFingerprint(b ^ 0x2545f4914f6cdd1dULL);
+    hasFingerprint = true;
+}
+
 // dump data to stdout
 void Relation::dump() {
     printf("\nRelation: %s", getPrintName());
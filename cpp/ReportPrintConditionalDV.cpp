@@ -878,12 +878,7 @@ void Report::printConditional_DV(FILE *fd, Model *model, Relation *rel, bool cal
         key_order[i] = i;
     
     
-    sort_var_list = var_list;
-    sort_count = iv_count;
-    sort_vars = ind_vars;
-    sort_keys = fit_key;
-    
-    qsort(key_order, iv_statespace, sizeof(int), sortKeys);
+    sortKeyOrder(key_order, iv_statespace, var_list, iv_count, ind_vars, fit_key, NULL);
 
     // Prep for P-MARGIN, P-RULE
     // Make table containing univorm distribution of DV cardinality
@@ -7,6 +7,9 @@
 
 #include "Key.h"
 #include "Model.h"
+#include "Table.h"
+#include "VariableList.h"
+#include <algorithm>
 #include <cctype>
 #include <cstring>
 //-- support routines for quicksort. The static variables
@@ -83,6 +86,53 @@ int sortKeys(const void *d1, const void *d2) {
 }
 
 
+void sortKeyOrder(int *order, long long count, VariableList *varlist, int var_count,
+                  int *vars, KeySegment **keys, Table *table) {
+    //-- LSD order: a stable counting sort on each variable, last variable first.
+    //-- Each variable's values are first ranked by their printed names, so the
+    //-- result matches sortKeys (including "?" for values outside the cardinality).
+    int *temp = new int[count];
+    for (int j = var_count - 1; j >= 0; j--) {
+        int v = (vars == NULL) ? j : vars[j];
+        //-- codes 0..cardinality-1 are the values; every code past them (including
+        //-- DONT_CARE) prints as "?", and shares the extra slot at the end
+        Variable *var = varlist->getVariable(v);
+        int cardinality = std::min(var->cardinality, MAXCARDINALITY);
+        int valueCount = cardinality + 1;
+        auto name = [&](int code) { return code < cardinality ? varlist->getVarValue(v, code) : "?"; };
+        int *byName = new int[valueCount];
+        int *rank = new int[valueCount];
+        long long *offsets = new long long[valueCount + 1];
+        for (int i = 0; i < valueCount; i++) { byName[i] = i; }
+        std::stable_sort(byName, byName + valueCount, [&](int a, int b) {
+            return strcmpAccountingForNumbers(name(a), name(b)) < 0;
+        });
+        rank[byName[0]] = 0;
+        for (int i = 1; i < valueCount; i++) {
+            bool same = strcmpAccountingForNumbers(name(byName[i - 1]), name(byName[i])) == 0;
+            rank[byName[i]] = rank[byName[i - 1]] + (same ? 0 : 1);
+        }
+
+        memset(offsets, 0, (valueCount + 1) * sizeof(long long));
+        for (long long i = 0; i < count; i++) {
+            KeySegment *key = keys ? keys[order[i]] : table->getKey(order[i]);
+            KeySegment code = (key[var->segment] & var->mask) >> var->shift;
+            temp[i] = rank[code < (KeySegment) cardinality ? code : cardinality];
+            offsets[temp[i] + 1]++;
+        }
+        for (int r = 0; r < valueCount; r++) { offsets[r + 1] += offsets[r]; }
+        int *sorted = new int[count];
+        for (long long i = 0; i < count; i++) {
+            sorted[offsets[temp[i]]++] = order[i];
+        }
+        memcpy(order, sorted, count * sizeof(int));
+        delete[] sorted;
+        delete[] offsets;
+        delete[] rank;
+        delete[] byName;
+    }
+    delete[] temp;
+}
 
 
 void orderIndices(const char **stringArray, int len, int *order) {
@@ -18,6 +18,23 @@
 #include <iostream>
 using namespace std;
 
+//-- the model made of start's relations (except the skipped ones) plus newRel,
+//-- normalized. The model cache is probed before any model is built.
+static Model *makeParentModel(ManagerBase *manager, Model *start, Relation *newRel,
+        int skip1 = -1, int skip2 = -1, bool *fromCache = NULL) {
+    int count = start->getRelationCount();
+    Relation **rels = new Relation*[count + 1];
+    int relCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (i != skip1 && i != skip2)
+            rels[relCount++] = start->getRelation(i);
+    }
+    rels[relCount++] = newRel;
+    Model *model = manager->getModelCache()->findOrAddModel(rels, relCount, fromCache);
+    delete[] rels;
+    return model;
+}
+
 //----- Full search down through the lattice -----
 
 Model **SearchFullDown::search(Model *start) {
@@ -148,16 +165,9 @@ static void getComplement(int *innerList, int innerListCount, int *outerList, in
 
 //-- check the given variable list to see if it is a subset of the given relation
 bool varSubset(int *vars, int varcount, Relation *rel) {
-    int i, j;
-    int relvarcount = rel->getVariableCount();
-    int *relvars = rel->getVariables();
-    for (i = 0; i < varcount; i++) {
-        for (j = 0; j < relvarcount; j++) {
-            if (vars[i] == relvars[j])
-                break;
-        }
-        //-- if got to the end of the list, no match
-        if (j >= relvarcount)
+    const VarSet &relvars = rel->getVarSet();
+    for (int i = 0; i < varcount; i++) {
+        if (!relvars.has(vars[i]))
             return false;
     }
     return true;
@@ -285,15 +295,9 @@ void SearchFullUp::makeCandidate(SearchStackEntry *stack, int top, Model *start)
     }
     Relation::sort(vars, varcount);
     Relation *rel = manager->getRelation(vars, varcount, true);
-    Model *newModel = new Model(start->getRelationCount() + 1);
-    newModel->copyRelations(*start);
-    newModel->addRelation(rel, true);
-    ModelCache *cache = manager->getModelCache();
-    if (!cache->addModel(newModel)) {
-        //-- already exists in cache; return that one
-        Model *cachedModel = cache->findModel(newModel->getPrintName());
-        delete newModel;
-        newModel = cachedModel;
+    bool fromCache;
+    Model *newModel = makeParentModel(manager, start, rel, -1, -1, &fromCache);
+    if (fromCache) {
         //-- since all models come from the cache, we can do pointer compares to see if
         //-- this model is already in the list. The model might also be the current model
         if (newModel == start)
@@ -607,7 +611,7 @@ Model **SearchLooplessDown::search(Model *start) {
                 Relation *rel;
                 for (relNumber = 0; relNumber < relCount; relNumber++) {
                     rel = start->getRelation(relNumber);
-                    if (ocContainsVariables(rel->getVariableCount(), rel->getVariables(), 2, pair)) {
+                    if (varSubset(pair, 2, rel)) {
                         if (++includeCount > 1)
                             break; //pair in more than one relation
                         includeID = relNumber;
@@ -879,7 +883,7 @@ Model **SearchLooplessUp::search(Model *start) {
     if (!varList->isDirected()) {
         maxChildren = 4;
         Model **models = new Model *[maxChildren];
-        Model *model, *cachedModel;
+        Model *model;
         memset(models, 0, maxChildren * sizeof(Model*));
         int modelsFound = 0;
         int *pair = new int[2];
@@ -907,17 +911,9 @@ Model **SearchLooplessUp::search(Model *start) {
                                         newRelVarCount++;
                                     }
                                 }
-                                model = new Model(relcount+1);
-                                model->copyRelations(*start);
                                 newRel = manager->getRelation(newRelVars, newRelVarCount, true);
-                                model->addRelation(newRel, true);
-                                // put the model in the cache, or use the cached one if already there
-                                ModelCache *cache = manager->getModelCache();
-                                if (!cache->addModel(model)) {
-                                    cachedModel = cache->findModel(model->getPrintName());
-                                    delete model;
-                                    model = cachedModel;
-                                }
+                                // use the cached model if already there
+                                model = makeParentModel(manager, start, newRel);
                                 if (manager->hasLoops(model))
                                     continue;
                                 // check if this model is in the return list, so we don't add a duplicate
@@ -974,21 +970,13 @@ Model **SearchLooplessUp::search(Model *start) {
                 continue;
             Relation *rel = start->getRelation(r);
             if (-1 == rel->findVariable(i)) {
-                model = new Model(relcount + 1);
-                model->copyRelations(*start, r);
                 int relvarcount = rel->getVariableCount();
                 int *relvars = new int[relvarcount + 1];
                 rel->copyVariables(relvars, relvarcount);
                 relvars[relvarcount++] = i;
                 Relation *newRelation = manager->getRelation(relvars, relvarcount, true);
-                model->addRelation(newRelation);
-                //-- put in cache, or use the cached one if already there
-                ModelCache *cache = manager->getModelCache();
-                if (!cache->addModel(model)) {
-                    Model *cachedModel = cache->findModel(model->getPrintName());
-                    delete model;
-                    model = cachedModel;
-                }
+                //-- use the cached model if already there
+                model = makeParentModel(manager, start, newRelation, r);
                 if (((VBMManager *) manager)->applyFilter(model)) {
                     models[slot++] = model;
                 }
@@ -1070,20 +1058,12 @@ Model **SearchDisjointUp::search(Model *start) {
                 }
             }
             if (!varfound) {
-                model = new Model(relcount + 1);
-                model->copyRelations(*start);
                 int *relvars = new int[2];
                 relvars[0] = i;
                 relvars[1] = depVar;
                 Relation *newRelation = manager->getRelation(relvars, 2, true);
-                model->addRelation(newRelation);
-                //-- put in cache, or use the cached one if already there
-                ModelCache *cache = manager->getModelCache();
-                if (!cache->addModel(model)) {
-                    Model *cachedModel = cache->findModel(model->getPrintName());
-                    delete model;
-                    model = cachedModel;
-                }
+                //-- use the cached model if already there
+                model = makeParentModel(manager, start, newRelation);
                 if (((VBMManager *) manager)->applyFilter(model))
                     models[slot++] = model;
             }
@@ -1098,8 +1078,6 @@ Model **SearchDisjointUp::search(Model *start) {
         for (r2 = r + 1; r2 < relcount; r2++) {
             if (r2 == indOnlyRel)
                 continue;
-            model = new Model(relcount + 1);
-            model->copyRelations(*start, r, r2);
             rel = start->getRelation(r);
             rel2 = start->getRelation(r2);
             relvarcount = rel->getVariableCount() + rel2->getVariableCount();
@@ -1112,14 +1090,8 @@ Model **SearchDisjointUp::search(Model *start) {
             int copycount = rel->copyVariables(relvars, relvarcount);
             copycount += rel2->copyVariables(relvars + copycount, relvarcount - copycount, depVar);
             Relation *newRelation = manager->getRelation(relvars, copycount, true);
-            model->addRelation(newRelation);
-            //-- put in cache, or use the cached one if already there
-            ModelCache *cache = manager->getModelCache();
-            if (!cache->addModel(model)) {
-                Model *cachedModel = cache->findModel(model->getPrintName());
-                delete model;
-                model = cachedModel;
-            }
+            //-- use the cached model if already there
+            model = makeParentModel(manager, start, newRelation, r, r2);
             if (((VBMManager *) manager)->applyFilter(model))
                 models[slot++] = model;
         }
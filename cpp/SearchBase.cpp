@@ -29,7 +29,7 @@ SearchType searchTypes[] = {
 };
 
 
-SearchBase::SearchBase(): manager(0), directed(false)
+SearchBase::SearchBase(): manager(0), directed(false), name("")
 {
 }
 
@@ -63,6 +63,7 @@ SearchBase* SearchFactory::getSearchMethod(ManagerBase *mgr, const char *name, b
         search->setDirected(mgr->getVariableList()->isDirected());
         search->setMakeProjection(proj);
         search->setManager(mgr);
+        search->setName(type->name);
     }
     return search;
 }
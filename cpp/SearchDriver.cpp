@@ -0,0 +1,412 @@
+/*
+ * Copyright © 1990 The Portland State University OCCAM Project Team
+ * [This program is licensed under the GPL version 3 or later.]
+ * Please see the file LICENSE in the source
+ * distribution of this software for license terms.
+ */
+
+#include "SearchDriver.h"
+#include "AttributeList.h"
+#include "Constants.h"
+#include "Report.h"
+#include "SBMManager.h"
+#include "SearchBase.h"
+#include "Table.h"
+#include "VBMManager.h"
+#include "Variable.h"
+#include "VariableList.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+SearchDriver::SearchDriver(VBMManager *mgr) :
+        manager(mgr), vbManager(mgr), sbManager(NULL), width(3), sortAttr(NULL),
+        sortDirection(Direction::Descending), evict(false), incrementalAlpha(false),
+        generatedCount(0), searchedCount(0), keptCount(0) {
+    setSortAttr(ATTRIBUTE_EXPLAINED_I);
+}
+
+SearchDriver::SearchDriver(SBMManager *mgr) :
+        manager(mgr), vbManager(NULL), sbManager(mgr), width(3), sortAttr(NULL),
+        sortDirection(Direction::Descending), evict(false), incrementalAlpha(false),
+        generatedCount(0), searchedCount(0), keptCount(0) {
+    setSortAttr(ATTRIBUTE_EXPLAINED_I);
+}
+
+SearchDriver::~SearchDriver() {
+    if (sortAttr)
+        delete[] sortAttr;
+}
+
+void SearchDriver::setSortAttr(const char *name) {
+    if (sortAttr)
+        delete[] sortAttr;
+    sortAttr = new char[strlen(name) + 1];
+    strcpy(sortAttr, name);
+}
+
+SearchBase *SearchDriver::getSearch() {
+    return vbManager ? vbManager->getSearch() : sbManager->getSearch();
+}
+
+//-- the statistics which don't need a fit table
+bool SearchDriver::needsFit() {
+    static const char *noFit[] = { "df", "ddf", "bp_t", "bp_information", "bp_alpha", "pct_correct_data", NULL };
+    for (const char **name = noFit; *name; name++) {
+        if (strcmp(sortAttr, *name) == 0)
+            return false;
+    }
+    return true;
+}
+
+//-- compute just what the sort attribute needs, to avoid any extra expensive
+//-- computations on models which won't be kept
+void SearchDriver::computeSortStatistic(Model *model) {
+    if (strcmp(sortAttr, "h") == 0 || strcmp(sortAttr, "information") == 0
+            || strcmp(sortAttr, "unexplained") == 0 || strcmp(sortAttr, "alg_t") == 0) {
+        if (vbManager)
+            vbManager->computeInformationStatistics(model);
+        else
+            sbManager->computeInformationStatistics(model);
+    } else if (strcmp(sortAttr, "df") == 0 || strcmp(sortAttr, "ddf") == 0) {
+        if (vbManager)
+            vbManager->computeDFStatistics(model);
+        else
+            sbManager->computeDFStatistics(model);
+    } else if (strcmp(sortAttr, "bp_t") == 0 || strcmp(sortAttr, "bp_information") == 0
+            || strcmp(sortAttr, "bp_alpha") == 0) {
+        if (vbManager)
+            vbManager->computeBPStatistics(model);
+        else
+            sbManager->computeBPStatistics(model);
+    } else if (strcmp(sortAttr, "pct_correct_data") == 0) {
+        if (vbManager)
+            vbManager->computePercentCorrect(model);
+        else
+            sbManager->computePercentCorrect(model);
+    } else {
+        //-- anything else, just compute everything we might need
+        if (vbManager) {
+            vbManager->computeL2Statistics(model);
+            vbManager->computeDependentStatistics(model);
+        } else {
+            sbManager->computeL2Statistics(model);
+            sbManager->computeDependentStatistics(model);
+        }
+    }
+}
+
+bool SearchDriver::isBetter(Model *a, Model *b) {
+    double a1 = a->getAttribute(sortAttr);
+    double a2 = b->getAttribute(sortAttr);
+    if (a1 != a2)
+        return sortDirection == Direction::Descending ? a1 > a2 : a1 < a2;
+    //-- break ties on the name, so the result doesn't depend on generation order
+    return strcmp(a->getPrintName(), b->getPrintName()) < 0;
+}
+
+//-- offer a scored model to the heap of the best width models. The heap is ordered
+//-- so that the worst of them is at the top, to be replaced by a better candidate.
+//-- State-based models are all kept as candidates, since they are checked for
+//-- equivalence (which is not transitive) in rank order, once the level is done.
+void SearchDriver::addCandidate(Model *model) {
+    auto worse = [this](Model *a, Model *b) { return isBetter(a, b); };
+    if (model->isStateBased()) {
+        heap.push_back(model);
+    } else if ((long) heap.size() < width) {
+        heap.push_back(model);
+        std::push_heap(heap.begin(), heap.end(), worse);
+    } else if (isBetter(model, heap[0])) {
+        std::pop_heap(heap.begin(), heap.end(), worse);
+        heap.back() = model;
+        std::push_heap(heap.begin(), heap.end(), worse);
+    }
+}
+
+Model **SearchDriver::processLevel(int level, Model **oldModels, long oldCount) {
+    generatedCount = 0;
+    searchedCount = 0;
+    keptCount = 0;
+    heap.clear();
+    SearchBase *search = getSearch();
+    std::vector<Model*> newModels;
+    bool fit = needsFit();
+    //-- with warm starts, the models fitted in this level keep copies of their fits
+    bool warm = fit && manager->isWarmStarting();
+    if (warm)
+        manager->setKeepFits(true);
+    for (long k = 0; search && k < oldCount; k++) {
+        Model *progenitor = oldModels[k];
+        Model **models = search->search(progenitor);
+        if (models == NULL)
+            continue;
+        //-- the models this search has not seen before
+        long firstNew = newModels.size();
+        for (Model **model = models; *model; model++) {
+            searchedCount++;
+            if ((*model)->getAttribute(ATTRIBUTE_PROCESSED) <= 0.0) {
+                (*model)->setAttribute(ATTRIBUTE_PROCESSED, 1.0);
+                (*model)->setAttribute(ATTRIBUTE_LEVEL, level);
+                (*model)->setProgenitor(progenitor);
+                newModels.push_back(*model);
+            } else if (incrementalAlpha) {
+                //-- this model has been made already, but this progenitor might lead to a
+                //-- better incremental alpha, so keep the better of the two
+                manager->compareProgenitors(*model, progenitor);
+            }
+        }
+        delete[] models;
+        long newCount = newModels.size() - firstNew;
+        //-- fit the looped models in parallel (with search-threads > 1) before scoring
+        if (fit && newCount > 0)
+            manager->fitModels(&newModels[firstNew], newCount);
+        for (long i = firstNew; i < (long) newModels.size(); i++) {
+            computeSortStatistic(newModels[i]);
+            addCandidate(newModels[i]);
+        }
+    }
+    generatedCount = newModels.size();
+    //-- the progenitors' children are all fitted, so their fits aren't needed again
+    if (warm) {
+        for (long k = 0; k < oldCount; k++)
+            oldModels[k]->deleteFitTable();
+    }
+
+    std::sort(heap.begin(), heap.end(), [this](Model *a, Model *b) { return isBetter(a, b); });
+    Model **kept = new Model*[width + 1];
+    for (long i = 0; i < (long) heap.size() && keptCount < width; i++) {
+        bool found = false;
+        for (long j = 0; j < keptCount && heap[i]->isStateBased(); j++) {
+            if (kept[j]->isEquivalentTo(heap[i])) {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            kept[keptCount++] = heap[i];
+    }
+    kept[keptCount] = NULL;
+    heap.clear();
+
+    //-- only the kept models can be progenitors at the next level
+    if (evict || warm) {
+        for (long i = 0; i < generatedCount; i++) {
+            Model *model = newModels[i];
+            if (std::find(kept, kept + keptCount, model) != kept + keptCount)
+                continue;
+            if (evict)
+                manager->deleteModelFromCache(model);
+            else
+                model->deleteFitTable();
+        }
+    }
+    if (warm)
+        manager->setKeepFits(false);
+    return kept;
+}
+
+//-- checkpoint file layout (native byte order):
+//--   magic, version, fingerprint, level
+//--   model count, and how many of those are in the report; for each model: name, ID, progenitor index (-1 if none),
+//--     attribute count, and each attribute's name and value
+//--   kept count; the index of each kept model
+//-- Models which are kept but not in the report are stored after the report's.
+static const char checkpointMagic[8] = { 'O', 'C', 'C', 'A', 'M', 'C', 'K', 'P' };
+static const int checkpointVersion = 2;
+
+static void writeString(FILE *fd, const char *str) {
+    int len = strlen(str);
+    fwrite(&len, sizeof(len), 1, fd);
+    fwrite(str, 1, len, fd);
+}
+
+static bool readString(FILE *fd, std::string &str) {
+    int len;
+    if (fread(&len, sizeof(len), 1, fd) != 1 || len < 0)
+        return false;
+    str.resize(len);
+    return len == 0 || fread(&str[0], 1, len, fd) == (size_t) len;
+}
+
+//-- attribute lists keep the name pointers they are given, so names read from a
+//-- checkpoint are kept here for the life of the program
+static const char *internName(const std::string &name) {
+    static std::set<std::string> names;
+    return names.insert(name).first->c_str();
+}
+
+//-- what a checkpoint is only valid for: the data (tuple counts, sample sizes and
+//-- variables) and the settings which decide the models of each level
+std::string SearchDriver::getFingerprint() {
+    std::string print;
+    char buf[200];
+    Table *input = manager->getInputData();
+    Table *test = manager->getTestData();
+    snprintf(buf, sizeof(buf), "data %lld %lld %.17g %.17g;", input ? input->getTupleCount() : 0LL,
+            test ? test->getTupleCount() : 0LL, manager->getSampleSz(), manager->getTestSampleSize());
+    print += buf;
+    VariableList *vars = manager->getVariableList();
+    for (int i = 0; i < vars->getVarCount(); i++) {
+        Variable *var = vars->getVariable(i);
+        snprintf(buf, sizeof(buf), " %s %s %d %d;", var->name, var->abbrev, var->cardinality, var->dv ? 1 : 0);
+        print += buf;
+    }
+    SearchBase *search = getSearch();
+    snprintf(buf, sizeof(buf), " search %s %d %d %d;", search ? search->getName() : "",
+            manager->getSearchDirection() == Direction::Descending ? 1 : 0,
+            sortDirection == Direction::Descending ? 1 : 0, width);
+    print += buf;
+    print += " sort ";
+    print += sortAttr;
+    return print;
+}
+
+bool SearchDriver::writeCheckpoint(const char *path, int level, Model **kept, long keptCount, Report *report) {
+    std::vector<Model*> models;
+    std::map<Model*, long> index;
+    for (long i = 0; i < report->getModelCount(); i++) {
+        Model *model = report->getModel(i);
+        if (index.insert(std::make_pair(model, (long) models.size())).second)
+            models.push_back(model);
+    }
+    long long reported = models.size();
+    for (long i = 0; i < keptCount; i++) {
+        if (index.insert(std::make_pair(kept[i], (long) models.size())).second)
+            models.push_back(kept[i]);
+    }
+
+    std::string tmpPath = std::string(path) + ".tmp";
+    FILE *fd = fopen(tmpPath.c_str(), "wb");
+    if (fd == NULL)
+        return false;
+    fwrite(checkpointMagic, 1, sizeof(checkpointMagic), fd);
+    fwrite(&checkpointVersion, sizeof(checkpointVersion), 1, fd);
+    writeString(fd, getFingerprint().c_str());
+    fwrite(&level, sizeof(level), 1, fd);
+    long long count = models.size();
+    fwrite(&count, sizeof(count), 1, fd);
+    fwrite(&reported, sizeof(reported), 1, fd);
+    for (long i = 0; i < (long) models.size(); i++) {
+        Model *model = models[i];
+        writeString(fd, model->getPrintName());
+        int id = model->getID();
+        fwrite(&id, sizeof(id), 1, fd);
+        std::map<Model*, long>::iterator progenitor = index.find(model->getProgenitor());
+        long long progIndex = progenitor == index.end() ? -1 : progenitor->second;
+        fwrite(&progIndex, sizeof(progIndex), 1, fd);
+        AttributeList *attrs = model->getAttributeList();
+        int attrCount = attrs->getAttributeCount();
+        fwrite(&attrCount, sizeof(attrCount), 1, fd);
+        for (int j = 0; j < attrCount; j++) {
+            writeString(fd, attrs->getAttributeName(j));
+            double value = attrs->getAttributeByIndex(j);
+            fwrite(&value, sizeof(value), 1, fd);
+        }
+    }
+    count = keptCount;
+    fwrite(&count, sizeof(count), 1, fd);
+    for (long i = 0; i < keptCount; i++) {
+        long long keptIndex = index[kept[i]];
+        fwrite(&keptIndex, sizeof(keptIndex), 1, fd);
+    }
+    bool ok = !ferror(fd);
+    if (fclose(fd) != 0)
+        ok = false;
+    if (ok && rename(tmpPath.c_str(), path) != 0)
+        ok = false;
+    if (!ok)
+        remove(tmpPath.c_str());
+    return ok;
+}
+
+//-- a model as stored in a checkpoint
+struct CheckpointModel {
+        std::string name;
+        int id;
+        long long progenitor;
+        std::vector<std::pair<std::string, double> > attrs;
+};
+
+Model **SearchDriver::readCheckpoint(const char *path, int *level, int *lastID, Report *report) {
+    FILE *fd = fopen(path, "rb");
+    if (fd == NULL)
+        return NULL;
+    //-- read the whole file before making any models, so a bad file changes nothing
+    char magic[sizeof(checkpointMagic)];
+    int version, savedLevel;
+    std::string fingerprint;
+    long long count, reported;
+    bool ok = fread(magic, 1, sizeof(magic), fd) == sizeof(magic)
+            && memcmp(magic, checkpointMagic, sizeof(magic)) == 0
+            && fread(&version, sizeof(version), 1, fd) == 1 && version == checkpointVersion
+            && readString(fd, fingerprint);
+    if (ok && fingerprint != getFingerprint()) {
+        fclose(fd);
+        printf("WARNING: checkpoint %s is from a different search or data; not resuming\n", path);
+        return NULL;
+    }
+    ok = ok && fread(&savedLevel, sizeof(savedLevel), 1, fd) == 1 && fread(&count, sizeof(count), 1, fd) == 1
+            && fread(&reported, sizeof(reported), 1, fd) == 1 && count >= 0 && reported >= 0 && reported <= count;
+    std::vector<CheckpointModel> saved;
+    for (long long i = 0; ok && i < count; i++) {
+        CheckpointModel model;
+        int attrCount;
+        ok = readString(fd, model.name) && fread(&model.id, sizeof(model.id), 1, fd) == 1
+                && fread(&model.progenitor, sizeof(model.progenitor), 1, fd) == 1
+                && fread(&attrCount, sizeof(attrCount), 1, fd) == 1;
+        for (int j = 0; ok && j < attrCount; j++) {
+            std::pair<std::string, double> attr;
+            ok = readString(fd, attr.first) && fread(&attr.second, sizeof(attr.second), 1, fd) == 1;
+            model.attrs.push_back(attr);
+        }
+        saved.push_back(model);
+    }
+    std::vector<long long> keptIndex;
+    long long savedKept;
+    if (ok)
+        ok = fread(&savedKept, sizeof(savedKept), 1, fd) == 1 && savedKept >= 0;
+    for (long long i = 0; ok && i < savedKept; i++) {
+        long long index;
+        ok = fread(&index, sizeof(index), 1, fd) == 1 && index >= 0 && index < count;
+        keptIndex.push_back(index);
+    }
+    fclose(fd);
+    if (!ok) {
+        printf("WARNING: ignoring unreadable checkpoint %s\n", path);
+        return NULL;
+    }
+
+    std::vector<Model*> models;
+    for (long i = 0; i < (long) saved.size(); i++) {
+        const char *name = saved[i].name.c_str();
+        Model *model = sbManager ? manager->makeSbModel(name, true) : manager->makeModel(name, true);
+        if (model == NULL) {
+            printf("WARNING: ignoring unreadable checkpoint %s\n", path);
+            return NULL;
+        }
+        models.push_back(model);
+    }
+    *lastID = 0;
+    for (long i = 0; i < (long) saved.size(); i++) {
+        Model *model = models[i];
+        for (long j = 0; j < (long) saved[i].attrs.size(); j++)
+            model->setAttribute(internName(saved[i].attrs[j].first), saved[i].attrs[j].second);
+        model->setID(saved[i].id);
+        if (saved[i].id > *lastID)
+            *lastID = saved[i].id;
+        if (saved[i].progenitor >= 0 && saved[i].progenitor < count)
+            model->setProgenitor(models[saved[i].progenitor]);
+        if (i < reported)
+            report->addModel(model);
+    }
+    *level = savedLevel;
+    Model **kept = new Model*[keptIndex.size() + 1];
+    for (keptCount = 0; keptCount < (long) keptIndex.size(); keptCount++)
+        kept[keptCount] = models[keptIndex[keptCount]];
+    kept[keptCount] = NULL;
+    return kept;
+}
@@ -7,6 +7,7 @@
 
 #include "Key.h"
 #include "Table.h"
+#include "VariableList.h"
 #include "_Core.h"
 
 #include <assert.h>
@@ -22,40 +23,82 @@ const long long GROWTH_FACTOR = 2;
  * to allocate storage.  The max number of tuples can be changed after creation, but
  * the keysize cannot.
  *
- * The data storage consists of {[keyseg 0]..[keyseg n][value]}..., in a contiguous
- * array. The macros below provide indexed access to this storage. Note that in order
- * for quicksort to work, the key must be first
+ * For interleaved tables, the data storage consists of {[keyseg 0]..[keyseg n][value]}...,
+ * in a contiguous array. For columnar tables, data holds only the keys, packed end to
+ * end, and the values are kept in a separate contiguous array, so that loops over the
+ * values don't have to pull every key through the cache. Either way, keyAt() and
+ * valueAt() give indexed access through the strides set by setLayoutPointers().
  */
 
 #define TupleBytes (sizeof(ocTupleValue) + keysize * sizeof(KeySegment))
 
+static_assert(sizeof(KeySegment) == sizeof(ocTupleValue), "interleaved tuples assume equal key and value widths");
 
-static ocTupleValue *ValuePtr(void *data, int keysize, long long index)
+
+Table::Table(int keysz, long long maxTuples, TableType typ, TableLayout lay)
 {
-    return ((ocTupleValue*) ( ((char*) data) + (keysize * sizeof(KeySegment)) + TupleBytes * (index) ));
+    keysize = keysz;
+    type = typ;
+    layout = lay;
+    maxTupleCount = maxTuples;
+    tupleCount = 0;
+    hashSlots = NULL;
+    hashSlotCount = 0;
+    denseDigits = NULL;
+    denseDigitCount = 0;
+    denseIndex = NULL;
+    if (layout == TableLayout::Columnar) {
+        data = new char[keysize * sizeof(KeySegment) * maxTuples];
+        memset(data, 0, keysize * sizeof(KeySegment) * maxTuples);
+        values = (ocTupleValue*) new char[sizeof(ocTupleValue) * maxTuples];
+        memset(values, 0, sizeof(ocTupleValue) * maxTuples);
+    } else {
+        data = new char[TupleBytes * maxTuples];
+        memset(data, 0, TupleBytes * maxTuples * sizeof(char));
+    }
+    setLayoutPointers();
 }
 
 
-static KeySegment *KeyPtr(void *data, int keysize, long long index)
+/**
+ * setLayoutPointers - set the key and value strides (in words), and the start of the
+ * values, after the storage or keysize changes.
+ */
+void Table::setLayoutPointers()
 {
-    return ((KeySegment*) ( ((char*) data) + TupleBytes * (index) ));
+    if (layout == TableLayout::Columnar) {
+        keyStride = keysize;
+        valueStride = 1;
+    } else {
+        keyStride = keysize + 1;
+        valueStride = keysize + 1;
+        values = (ocTupleValue*) ((KeySegment*) data + keysize);
+    }
 }
 
 
-Table::Table(int keysz, long long maxTuples, TableType typ)
+/**
+ * grow - increase the tuple storage by GROWTH_FACTOR.
+ */
+void Table::grow()
 {
-    keysize = keysz;
-    type = typ;
-    maxTupleCount = maxTuples;
-    tupleCount = 0;
-    data = new char[TupleBytes * maxTuples];
-    memset(data, 0, TupleBytes * maxTuples * sizeof(char));
+    if (layout == TableLayout::Columnar) {
+        data = growStorage(data, maxTupleCount * keysize * sizeof(KeySegment), GROWTH_FACTOR);
+        values = (ocTupleValue*) growStorage(values, maxTupleCount * sizeof(ocTupleValue), GROWTH_FACTOR);
+    } else {
+        data = growStorage(data, maxTupleCount*TupleBytes, GROWTH_FACTOR);
+    }
+    maxTupleCount *= GROWTH_FACTOR;
+    setLayoutPointers();
 }
 
 
 Table::~Table()
 {
     if (data) delete [] (char*)data;
+    if (layout == TableLayout::Columnar) delete [] (char*)values;
+    releaseHash();
+    releaseDenseIndex();
 }
 
 
@@ -67,11 +110,21 @@ long long Table::size()
 
 void Table::copy(const Table* from)
 {
+    releaseHash();
+    releaseDenseIndex();
     while (from->tupleCount > maxTupleCount) {
-        data = growStorage(data, maxTupleCount*TupleBytes, GROWTH_FACTOR);
-        maxTupleCount *= GROWTH_FACTOR;
+        grow();
+    }
+    if (from->layout == layout && from->keysize == keysize) {
+        memcpy(data, from->data, from->tupleCount * keyStride * sizeof(KeySegment));
+        if (layout == TableLayout::Columnar)
+            memcpy(values, from->values, from->tupleCount * sizeof(ocTupleValue));
+    } else {
+        for (long long i = 0; i < from->tupleCount; i++) {
+            memcpy(keyAt(i), from->keyAt(i), keysize * sizeof(KeySegment));
+            *valueAt(i) = *from->valueAt(i);
+        }
     }
-    memcpy(data, from->data, TupleBytes * maxTupleCount);
     tupleCount = from->tupleCount;
 }
 
@@ -82,15 +135,15 @@ void Table::copy(const Table* from)
  */
 void Table::addTuple(KeySegment *key, double value)
 {
+    if (denseIndex) releaseDenseIndex();
     while (tupleCount >= maxTupleCount) {
-        data = growStorage(data, maxTupleCount*TupleBytes, GROWTH_FACTOR);
-        maxTupleCount *= GROWTH_FACTOR;
+        grow();
     }
-    KeySegment *keyptr = KeyPtr(data, keysize, tupleCount);
+    KeySegment *keyptr = keyAt(tupleCount);
     memcpy(keyptr, key, sizeof(KeySegment) * keysize);			// copy key
     //-- for set relations, only values are 1 or 0
     if (type == TableType::SetTheoretic && value != 0.0) value = 1.0;
-    *(ValuePtr(data, keysize, tupleCount)) = (ocTupleValue) value;		// copy value
+    *(valueAt(tupleCount)) = (ocTupleValue) value;		// copy value
     tupleCount++;
 }
 
@@ -100,39 +153,125 @@ void Table::addTuple(KeySegment *key, double value)
  */
 void Table::insertTuple(KeySegment *key, double value, long long index)
 {
+    if (denseIndex) releaseDenseIndex();
     while (tupleCount >= maxTupleCount) {
-        data = growStorage(data, maxTupleCount*TupleBytes, GROWTH_FACTOR);
-        maxTupleCount *= GROWTH_FACTOR;
+        grow();
     }
     if (index < tupleCount) {
-        void* dest = KeyPtr(data, keysize, index + 1);
-        void* src = KeyPtr(data, keysize, index);
-        long size = ((char*)KeyPtr(data, keysize, tupleCount)) - ((char*)KeyPtr(data, keysize, index));
-        memmove(dest, src, size);
+        //-- for interleaved tables this moves the values along with the keys
+        memmove(keyAt(index + 1), keyAt(index), (tupleCount - index) * keyStride * sizeof(KeySegment));
+        if (layout == TableLayout::Columnar)
+            memmove(valueAt(index + 1), valueAt(index), (tupleCount - index) * sizeof(ocTupleValue));
     }
     // else?
 
-    KeySegment *keyptr = KeyPtr(data, keysize, index);
+    KeySegment *keyptr = keyAt(index);
     memcpy(keyptr, key, sizeof(KeySegment) * keysize);	// copy key
     //-- for set relations, only values are 1 or 0
     if (type == TableType::SetTheoretic && value != 0.0) value = 1.0;
-    *(ValuePtr(data, keysize, index)) = (ocTupleValue) value;						// copy value
+    *(valueAt(index)) = (ocTupleValue) value;						// copy value
     tupleCount++;
 }
 
 
+/**
+ * hashKey - mix the key segments into a hash value for the accumulation hash.
+ */
+static unsigned long long hashKey(KeySegment *key, int keysize)
+{
+    unsigned long long hash = 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < keysize; i++) {
+        hash ^= (unsigned long long) key[i];
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+
+/**
+ * beginHashAccumulation - switch the table into hash accumulation mode. Any tuples already
+ * in the table are indexed, so later calls to sumTuple will find them. The expected count
+ * is only a sizing hint; the hash grows as needed.
+ */
+void Table::beginHashAccumulation(long long expectedTuples)
+{
+    if (expectedTuples < tupleCount) expectedTuples = tupleCount;
+    long long slotCount = 16;
+    while (slotCount < expectedTuples * 2) slotCount *= 2;
+    rehash(slotCount);
+}
+
+
+/**
+ * finalize - leave hash accumulation mode, sorting the tuples so that indexOf works again.
+ */
+void Table::finalize()
+{
+    releaseHash();
+    sort();
+}
+
+
+/**
+ * rehash - rebuild the accumulation hash with the given number of slots (a power of 2).
+ */
+void Table::rehash(long long slotCount)
+{
+    releaseHash();
+    hashSlotCount = slotCount;
+    hashSlots = new long long[slotCount];
+    memset(hashSlots, 0xff, slotCount * sizeof(long long));
+    for (long long index = 0; index < tupleCount; index++) {
+        long long slot = hashKey(keyAt(index), keysize) & (slotCount - 1);
+        while (hashSlots[slot] >= 0) {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        hashSlots[slot] = index;
+    }
+}
+
+
+void Table::releaseHash()
+{
+    if (hashSlots) delete [] hashSlots;
+    hashSlots = NULL;
+    hashSlotCount = 0;
+}
+
+
 /**
  * sumTuple - if the tuple matching the key already exists, add this value
- * to it.  If not, add a new Tuple.
+ * to it.  If not, add a new Tuple.  In hash accumulation mode, new tuples
+ * are appended rather than inserted in order.
  */
 void Table::sumTuple(KeySegment *key, double value)
 {
+    if (hashSlots) {
+        //-- keep the load factor at or below 1/2, so probe sequences stay short
+        if ((tupleCount + 1) * 2 > hashSlotCount) rehash(hashSlotCount * 2);
+        long long slot = hashKey(key, keysize) & (hashSlotCount - 1);
+        long long index;
+        while ((index = hashSlots[slot]) >= 0) {
+            if (memcmp(keyAt(index), key, keysize * sizeof(KeySegment)) == 0) {
+                ocTupleValue *valuep = valueAt(index);
+                value += *valuep;
+                if (type == TableType::SetTheoretic && value != 0.0) value = 1.0;
+                *valuep = (ocTupleValue) value;
+                return;
+            }
+            slot = (slot + 1) & (hashSlotCount - 1);
+        }
+        hashSlots[slot] = tupleCount;
+        addTuple(key, value);
+        return;
+    }
     long long index = indexOf(key, false);
     //-- index is either the matching tuple, or the next higher one. So we have to test again.
-    if (index >= tupleCount || Key::compareKeys(KeyPtr(data, keysize, index), key, keysize) != 0) {
+    if (index >= tupleCount || Key::compareKeys(keyAt(index), key, keysize) != 0) {
         insertTuple(key, value, index);
     } else {
-        ocTupleValue *valuep = ValuePtr(data, keysize, index);
+        ocTupleValue *valuep = valueAt(index);
         value += *valuep;
         if (type == TableType::SetTheoretic && value != 0.0) value = 1.0;
         *valuep = (ocTupleValue) value;
@@ -148,7 +287,7 @@ void Table::sumTuple(KeySegment *key, double value)
 double Table::getValue(long long index)
 {
     if (index < 0 || index >= tupleCount) return 0.0;
-    return (double) *(ValuePtr(data, keysize, index));
+    return (double) *(valueAt(index));
 }
 
 
@@ -158,7 +297,7 @@ double Table::getValue(long long index)
 void Table::setValue(long long index, double value)
 {
     if ((index < 0) || (index >= tupleCount)) return;
-    else *(ValuePtr(data, keysize, index)) = (ocTupleValue) value;
+    else *(valueAt(index)) = (ocTupleValue) value;
 }
 
 
@@ -168,7 +307,7 @@ void Table::setValue(long long index, double value)
 KeySegment *Table::getKey(long long index)
 {
     if (index < 0 || index >= tupleCount) return 0;
-    else return KeyPtr(data, keysize, index);
+    else return keyAt(index);
 }
 
 
@@ -188,17 +327,30 @@ void Table::copyKey(long long index, KeySegment *key)
  */
 long long Table::indexOf(KeySegment *key, bool matchOnly)
 {
+    if (denseIndex && matchOnly) {
+        long long cell = 0;
+        for (int d = 0; d < denseDigitCount; d++) {
+            DenseDigit &digit = denseDigits[d];
+            int value = (key[digit.segment] & digit.mask) >> digit.shift;
+            if (value >= digit.cardinality) return -1;
+            cell += value * digit.stride;
+        }
+        long long index = denseIndex[cell];
+        //-- the cell only covers the indexed variables, so check the whole key
+        if (index < 0 || memcmp(keyAt(index), key, keysize * sizeof(KeySegment)) != 0) return -1;
+        return index;
+    }
     int compare;
     long long top = 0;
     long long bottom = tupleCount - 1;
     if (bottom < 0) return matchOnly ? -1 : 0;	// empty table
 
     // Handle ends of range first
-    compare = Key::compareKeys(KeyPtr(data, keysize, top), key, keysize);
+    compare = Key::compareKeys(keyAt(top), key, keysize);
     if (compare == 0) return top;
     else if (compare > 0) return matchOnly ? -1 : 0;
 
-    compare = Key::compareKeys(KeyPtr(data, keysize, bottom), key, keysize);
+    compare = Key::compareKeys(keyAt(bottom), key, keysize);
     if (compare == 0) return bottom;
     else if (compare < 0) return matchOnly ? -1 : tupleCount;
 
@@ -208,7 +360,7 @@ long long Table::indexOf(KeySegment *key, bool matchOnly)
     // Each iteration, the midpoint of the remaining range is checked, and
     // then half the keys are discarded.
     while (true) {
-        compare = Key::compareKeys(KeyPtr(data, keysize, mid), key, keysize);
+        compare = Key::compareKeys(keyAt(mid), key, keysize);
         if (compare == 0) return mid;	// got a match
         if (compare > 0) {	// search top half of range
             bottom = mid;
@@ -223,21 +375,163 @@ long long Table::indexOf(KeySegment *key, bool matchOnly)
 
 
 /**
- * sort() - sort the tuples by key value (to allow binary search).  This uses
- * the Unix QuickSort function qsort. We need a little adaptor function for the
- * comparator, because compareKeys isn't quite right
+ * buildDenseIndex - index every tuple by its cell number in the state space of the given
+ * variables. The table must already be sorted, and each tuple's key should only vary in
+ * these variables (as in a relation's projection).
  */
-static int sortKeySize;	// must be set before calling sortCompare
-static int sortCompare(const void *k1, const void *k2)
+void Table::buildDenseIndex(VariableList *vars, int *varIndices, int varCount)
 {
-    return Key::compareKeys((KeySegment *)k1, (KeySegment *)k2, sortKeySize);
+    releaseDenseIndex();
+    denseDigitCount = varCount;
+    denseDigits = new DenseDigit[varCount];
+    long long cells = 1;
+    for (int d = varCount - 1; d >= 0; d--) {
+        Variable *var = vars->getVariable(varIndices[d]);
+        denseDigits[d].segment = var->segment;
+        denseDigits[d].shift = var->shift;
+        denseDigits[d].mask = var->mask;
+        denseDigits[d].cardinality = var->cardinality;
+        denseDigits[d].stride = cells;
+        cells *= var->cardinality;
+    }
+    denseIndex = new int[cells];
+    memset(denseIndex, 0xff, cells * sizeof(int));
+    for (long long i = 0; i < tupleCount; i++) {
+        KeySegment *key = keyAt(i);
+        long long cell = 0;
+        for (int d = 0; d < denseDigitCount; d++) {
+            int value = (key[denseDigits[d].segment] & denseDigits[d].mask) >> denseDigits[d].shift;
+            if (value >= denseDigits[d].cardinality) {
+                //-- key doesn't fit the state space; stay with binary search
+                releaseDenseIndex();
+                return;
+            }
+            cell += value * denseDigits[d].stride;
+        }
+        denseIndex[cell] = i;
+    }
+}
+
+
+void Table::releaseDenseIndex()
+{
+    if (denseIndex) delete [] denseIndex;
+    if (denseDigits) delete [] denseDigits;
+    denseIndex = NULL;
+    denseDigits = NULL;
+    denseDigitCount = 0;
+}
+
+
+/**
+ * sort() - sort the tuples by key value (to allow binary search). Small tables use
+ * an insertion sort; larger ones use an LSD radix sort over the bytes of the key
+ * segments, least significant segment first. Both are stable, and neither needs any
+ * static state, so tables can be sorted concurrently.
+ */
+const long long RADIX_SORT_MIN_TUPLES = 64;
+
+void Table::insertionSort()
+{
+    KeySegment temp[keysize];
+    for (long long i = 1; i < tupleCount; i++) {
+        KeySegment *key = keyAt(i);
+        long long j = i;
+        while (j > 0 && Key::compareKeys(keyAt(j - 1), key, keysize) > 0) j--;
+        if (j == i) continue;
+        ocTupleValue value = *valueAt(i);
+        memcpy(temp, key, keysize * sizeof(KeySegment));
+        memmove(keyAt(j + 1), keyAt(j), (i - j) * keyStride * sizeof(KeySegment));
+        if (layout == TableLayout::Columnar)
+            memmove(valueAt(j + 1), valueAt(j), (i - j) * sizeof(ocTupleValue));
+        memcpy(keyAt(j), temp, keysize * sizeof(KeySegment));
+        *valueAt(j) = value;
+    }
+}
+
+
+void Table::radixSort()
+{
+    const long long count = tupleCount;
+    const int digits = keysize * sizeof(KeySegment);
+    long long *counts = new long long[digits * 256];
+    memset(counts, 0, digits * 256 * sizeof(long long));
+
+    //-- count every digit in a single pass. Digit d is byte (d % 8) of segment (d / 8),
+    //-- counting from the low-order byte.
+    for (long long i = 0; i < count; i++) {
+        KeySegment *key = keyAt(i);
+        for (int s = 0; s < keysize; s++) {
+            KeySegment seg = key[s];
+            long long *segCounts = counts + s * sizeof(KeySegment) * 256;
+            for (unsigned b = 0; b < sizeof(KeySegment); b++) {
+                segCounts[b * 256 + ((seg >> (8 * b)) & 0xff)]++;
+            }
+        }
+    }
+
+    //-- tuples are scattered back and forth between the table storage and a buffer
+    //-- with the same layout
+    KeySegment *srcKeys = (KeySegment*) data;
+    ocTupleValue *srcValues = values;
+    KeySegment *bufKeys = NULL;
+    ocTupleValue *bufValues = NULL;
+    KeySegment *dstKeys = NULL;
+    ocTupleValue *dstValues = NULL;
+    long long offsets[256];
+    for (int s = keysize - 1; s >= 0; s--) {
+        for (unsigned b = 0; b < sizeof(KeySegment); b++) {
+            long long *digitCounts = counts + (s * sizeof(KeySegment) + b) * 256;
+            //-- skip digits which are the same in every key (e.g., the unused high bytes)
+            int c;
+            for (c = 0; c < 256; c++) {
+                if (digitCounts[c] != 0) break;
+            }
+            if (digitCounts[c] == count) continue;
+
+            if (bufKeys == NULL) {
+                bufKeys = new KeySegment[count * keyStride];
+                bufValues = (layout == TableLayout::Columnar) ? new ocTupleValue[count]
+                                                              : (ocTupleValue*) (bufKeys + keysize);
+                dstKeys = bufKeys;
+                dstValues = bufValues;
+            }
+            long long total = 0;
+            for (c = 0; c < 256; c++) {
+                offsets[c] = total;
+                total += digitCounts[c];
+            }
+            for (long long i = 0; i < count; i++) {
+                KeySegment *key = srcKeys + keyStride * i;
+                long long pos = offsets[(key[s] >> (8 * b)) & 0xff]++;
+                memcpy(dstKeys + keyStride * pos, key, keysize * sizeof(KeySegment));
+                dstValues[valueStride * pos] = srcValues[valueStride * i];
+            }
+            KeySegment *swapKeys = srcKeys;
+            ocTupleValue *swapValues = srcValues;
+            srcKeys = dstKeys;
+            srcValues = dstValues;
+            dstKeys = swapKeys;
+            dstValues = swapValues;
+        }
+    }
+    if (srcKeys != (KeySegment*) data) {
+        memcpy(data, srcKeys, count * keyStride * sizeof(KeySegment));
+        if (layout == TableLayout::Columnar) memcpy(values, srcValues, count * sizeof(ocTupleValue));
+    }
+    if (bufKeys) {
+        delete [] bufKeys;
+        if (layout == TableLayout::Columnar) delete [] bufValues;
+    }
+    delete [] counts;
 }
 
 
 void Table::sort()
 {
-    sortKeySize = keysize;
-    qsort(data, tupleCount, TupleBytes, sortCompare);
+    releaseDenseIndex();
+    if (tupleCount < RADIX_SORT_MIN_TUPLES) insertionSort();
+    else radixSort();
 }
 
 
@@ -249,10 +543,10 @@ double Table::normalize()
     double denom = 0;
     long long i;
     for (i = 0; i < tupleCount; i++) {
-        denom += getValue(i);
+        denom += values[i * valueStride];
     }
     for (i = 0; i < tupleCount; i++) {
-        setValue(i, (getValue(i)/denom));
+        values[i * valueStride] /= denom;
     }
     //-- if the data was already normalized, then not much will have happened.
     //-- but in that case there is no sample size info, so return 1.
@@ -265,9 +559,8 @@ double Table::normalize()
 // Adds a constant to every value in the table.
 void Table::addConstant(double constant)
 {
-    long long i;
-    for (i = 0; i < tupleCount; i++) {
-        setValue(i, getValue(i) + constant);
+    for (long long i = 0; i < tupleCount; i++) {
+        values[i * valueStride] += constant;
     }
 }
 
@@ -277,8 +570,8 @@ double Table::getLowestValue()
 {
     double lowest = getValue(0);
     for (long long i = 0; i < tupleCount; i++) {
-        if (getValue(i) < lowest)
-            lowest = getValue(i);
+        if (values[i * valueStride] < lowest)
+            lowest = values[i * valueStride];
     }
     return lowest;
 }
@@ -289,8 +582,39 @@ double Table::getLowestValue()
  */
 void Table::reset(int keysize)
 {
+    releaseHash();
+    releaseDenseIndex();
     this->tupleCount = 0;
     this->keysize = keysize;
+    setLayoutPointers();
+}
+
+
+/**
+ * reserve - grow the storage to hold at least the given number of tuples in one step.
+ * Unlike growing through addTuple, only the tuples in use are copied, and the new
+ * space isn't zero-filled.
+ */
+void Table::reserve(long long tuples)
+{
+    if (tuples <= maxTupleCount) return;
+    if (layout == TableLayout::Columnar) {
+        char *newData = new char[tuples * keysize * sizeof(KeySegment)];
+        memcpy(newData, data, tupleCount * keysize * sizeof(KeySegment));
+        char *newValues = new char[tuples * sizeof(ocTupleValue)];
+        memcpy(newValues, values, tupleCount * sizeof(ocTupleValue));
+        delete [] (char*)data;
+        delete [] (char*)values;
+        data = newData;
+        values = (ocTupleValue*) newValues;
+    } else {
+        char *newData = new char[tuples * TupleBytes];
+        memcpy(newData, data, tupleCount * TupleBytes);
+        delete [] (char*)data;
+        data = newData;
+    }
+    maxTupleCount = tuples;
+    setLayoutPointers();
 }
 
 
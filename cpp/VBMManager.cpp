@@ -102,36 +102,23 @@ void VBMManager::makeAllChildRelations(Relation *rel, Relation **children, bool
 }
 
 Model *VBMManager::makeChildModel(Model *model, int remove, bool *fromCache, bool makeProject) {
-    Model *newModel = new Model(varList->getVarCount());
     int count = model->getRelationCount();
     if (remove >= count)
         return NULL; // bad argument
+    //-- collect the child's relations, and let the cache build the model only if
+    //-- it hasn't seen this one before
+    Relation *removed = model->getRelation(remove);
+    int varCount = removed->getVariableCount();
+    Relation **rels = new Relation*[count - 1 + varCount];
+    int relCount = 0;
     for (int i = 0; i < count; i++) {
-        Relation *rel = model->getRelation(i);
-        if (i == remove) {
-            int varCount = rel->getVariableCount();
-            Relation **children = new Relation*[varCount];
-            makeAllChildRelations(rel, children, makeProject);
-            for (int j = 0; j < varCount; j++) {
-                newModel->addRelation(children[j]);
-            }
-            delete children;
-        } else {
-            newModel->addRelation(rel);
-        }
-    }
-    //-- return one from cache if possible
-    if (!modelCache->addModel(newModel)) {
-        const char *name = newModel->getPrintName();
-        Model *cacheModel = modelCache->findModel(name);
-        delete newModel;
-        newModel = cacheModel;
-        if (fromCache)
-            *fromCache = true;
-    } else {
-        if (fromCache)
-            *fromCache = false;
+        if (i != remove)
+            rels[relCount++] = model->getRelation(i);
     }
+    makeAllChildRelations(removed, rels + relCount, makeProject);
+    relCount += varCount;
+    Model *newModel = modelCache->findOrAddModel(rels, relCount, fromCache);
+    delete[] rels;
     return newModel;
 }
 
@@ -674,14 +661,6 @@ double VBMManager::computeBPT(Model *model) {
     if (processor == NULL)
         processor = new BPIntersectProcessor(inputData, fullDimension);
     processor->reset(relCount);
-    if (intersectArray != NULL) {
-        delete[] intersectArray;
-        intersectCount = 0;
-        intersectMax = model->getRelationCount();
-        ;
-        intersectArray = NULL;
-    }
-
     doIntersectionProcessing(model, processor);
     modelT = processor->getTransmission();
     model->setAttribute(ATTRIBUTE_BP_T, modelT);
@@ -6,6 +6,7 @@
  */
 
 #include "VariableList.h"
+#include "ValueIndex.h"
 #include "_Core.h"
 #include <assert.h>
 #include <string.h>
@@ -60,6 +61,8 @@ VariableList::~VariableList() {
         }
         if (varp->exclude)
             delete[] varp->exclude;
+        delete varp->valueIndex;
+        delete varp->rebinIndex;
     }
     if (vars)
         delete vars;
@@ -133,6 +136,10 @@ int VariableList::addVariable(const char *name, const char *abbrev, int cardinal
 
     // clear the value map
     memset(varp->valmap, 0, MAXCARDINALITY * sizeof(const char *));
+    varp->valueCount = 0;
+    varp->valueIndex = new ValueIndex;
+    varp->rebinIndex = NULL;
+    varp->rebinWildcard = -1;
 
     return 0;
 }
@@ -166,10 +173,9 @@ int VariableList::markForNoUse() {
 /* This function returns the new binning value for an old one for a given variable
  */
 int VariableList::getNewValue(int index, char * old_value, char*new_value) {
-    int i = 0, k;
     int chr;
     char myvalue[100];
-    for (chr = 0; chr < 100; chr++) {
+    for (chr = 0; chr < 99; chr++) {
         if (old_value[chr] == '\0' || isspace(old_value[chr]) || old_value[chr] == ',')
             break;
         else
@@ -178,28 +184,41 @@ int VariableList::getNewValue(int index, char * old_value, char*new_value) {
     myvalue[chr] = '\0';
     //exclude case
     if ((vars + index)->exclude != NULL) {
-        if ((k = strcmp(myvalue, (vars + index)->exclude)) == 0)
+        if (strcmp(myvalue, (vars + index)->exclude) == 0)
             return -1;
         else {
             strcpy(new_value, myvalue);
             return 1;
         }
     }
-    for (;;) {
-        char * value_new = (vars + index)->oldnew[1][i];
-        char * value_old = (vars[index]).oldnew[0][i];
-        if (value_new == NULL)
-            break;
-        if ((k = strcmp(value_old, myvalue)) == 0) {
-            strcpy(new_value, value_new);
-            return 1;
-        } else if ((k = strcmp(value_old, "*")) == 0) {
-            strcpy(new_value, value_new);
-            return 1;
+    //-- the first entry in the map for this value, or for "*", whichever comes first.
+    //-- The index is built once the map is read (see indexRebinning), so this only
+    //-- reads it, and readers may call it from several threads.
+    Variable *varp = vars + index;
+    assert(varp->rebinIndex != NULL);
+    int entry = varp->rebinIndex->find(myvalue, chr);
+    if (entry < 0 || (varp->rebinWildcard >= 0 && varp->rebinWildcard < entry))
+        entry = varp->rebinWildcard;
+    if (entry < 0)
+        return -1;
+    strcpy(new_value, varp->oldnew[1][entry]);
+    return 1;
+}
+
+void VariableList::indexRebinning(int index) {
+    Variable *varp = vars + index;
+    delete varp->rebinIndex;
+    varp->rebinIndex = new ValueIndex;
+    varp->rebinWildcard = -1;
+    for (int i = 0; varp->oldnew[1][i] != NULL; i++) {
+        const char *value_old = varp->oldnew[0][i];
+        if (strcmp(value_old, "*") == 0) {
+            if (varp->rebinWildcard < 0)
+                varp->rebinWildcard = i;
+        } else {
+            varp->rebinIndex->add(value_old, strlen(value_old), i);
         }
-        i++;
     }
-    return -1;
 }
 
 /**
@@ -398,37 +417,32 @@ int VariableList::getVarStateList(const char *name, int *varlist, int *stlist) {
 }
 
 int VariableList::getVarValueIndex(int varindex, const char *value) {
-    int index = 0;
-    char **map = vars[varindex].valmap;
-    char myvalue[100];
+    Variable *varp = vars + varindex;
     int chr;
-    int cardinality = vars[varindex].cardinality;
-    //-- extract the name as a separate string
-    for (chr = 0; chr < 100; chr++) {
+    //-- the name is the value up to a separator
+    for (chr = 0; chr < 99; chr++) {
         if (value[chr] == '\0' || isspace(value[chr]) || (value[chr] == ','))
             break;
-        else
-            myvalue[chr] = value[chr];
-    }
-    myvalue[chr] = '\0';
-    //-- find this value in the value map. Stop on first empty entry
-    while (index < cardinality) {
-        if (map[index] == NULL)
-            break;
-        if (strcmp(myvalue, map[index]) == 0)
-            return index;
-        index++;
     }
+    int index = varp->valueIndex->find(value, chr);
+    if (index >= 0)
+        return index;
     //-- if we have room, add this value. Otherwise return error.
-    if (index < cardinality) {
-        map[index] = new char[strlen(value) + 1];
-        strcpy(map[index], myvalue);
+    if (varp->valueCount < varp->cardinality) {
+        index = varp->valueCount++;
+        varp->valmap[index] = new char[chr + 1];
+        strncpy(varp->valmap[index], value, chr);
+        varp->valmap[index][chr] = '\0';
+        varp->valueIndex->add(value, chr, index);
         return index;
     } else
         return -1;
 }
 
 const char *VariableList::getVarValue(int varindex, int valueindex) {
+    //-- codes past the cardinality (such as DONT_CARE) have no value
+    if (valueindex < 0 || valueindex >= vars[varindex].cardinality || valueindex >= MAXCARDINALITY)
+        return "?";
     char **map = vars[varindex].valmap;
     const char *value = map[valueindex];
     if (value)
@@ -8,6 +8,7 @@
 #include "VBMManager.h"
 #include "SBMManager.h"
 #include "SearchBase.h"
+#include "SearchDriver.h"
 #include "Report.h"
 #include <string.h>
 #include <stdio.h>
@@ -82,79 +83,57 @@ int main(int argc, char* argv[]) {
         mgr->computeDependentStatistics(start);
         mgr->computeIncrementalAlpha(start);
         start->setAttribute("level", 0.0);
-        report->addModel(start);
         int nextID = 0;
         mgr->setSortAttr("information");
         mgr->setSearchDirection(Direction::Ascending);
-        start->setID(nextID++);
 
-        Model **nextModels, **keptModels;
-        Model **model;
-        keptModels = new Model*[1];
-        keptModels[0] = start;
-        long count, levelCount, keptCount, nextCount, foundCount;
-        keptCount = 1;
-        Model** models;
-        bool found;
+        SearchDriver driver(mgr);
+        driver.setWidth((int)width);
+        driver.setSortAttr(mgr->getSortAttr());
+        driver.setSortDirection(Direction::Descending);
+        //-- resume from the checkpoint, if there is one
+        const char *checkpoint = NULL;
+        mgr->getOptionString("checkpoint-file", NULL, &checkpoint);
+        int firstLevel = 0, lastID;
+        Model **keptModels = checkpoint ? driver.readCheckpoint(checkpoint, &firstLevel, &lastID, report) : NULL;
+        long keptCount;
+        if (keptModels) {
+            keptCount = driver.getKeptCount();
+            nextID = lastID + 1;
+            printf("Resuming search from level %d checkpoint\n", firstLevel);
+        } else {
+            report->addModel(start);
+            start->setID(nextID++);
+            keptModels = new Model*[2];
+            keptModels[0] = start;
+            keptModels[1] = NULL;
+            keptCount = 1;
+        }
         t1 = clock();
         printf("Setup time: %f seconds\n", (float)(t1 - t0)/CLOCKS_PER_SEC);
-        for (int j=0; j < levels; j++) {
-            nextCount = 0;
-            nextModels = new Model*[keptCount * (int)width];
-            levelCount = 0;
+        for (int j=firstLevel; j < levels && keptCount > 0; j++) {
             printf("level: %d\t", j+1); fflush(stdout);
-            for (int k=0; k < keptCount; k++) {
-                models = mgr->getSearch()->search(keptModels[k]);
-                count = 0;
-                if (models) {
-                    for (model = models; *model; model++)
-                        count++;
-                    levelCount += count;
-                    for (int i=0; i < count; i++) {
-                        mgr->computeInformationStatistics(models[i]);
-                    }
-                    Report::sort(models, count, mgr->getSortAttr(), Direction::Descending);
-                    foundCount = 0;
-                    int i = 0;
-                    while ((foundCount < (width < count ? width : count)) && (i < count)) {
-                        found = false;
-                        for (int n=0; n < nextCount; n++) {
-                            if (nextModels[n] == models[i] || nextModels[n]->isEquivalentTo(models[i])) {
-                                found = true;
-                                break;
-                            }
-                        }
-                        if (!found) {
-                            foundCount++;
-                            nextModels[nextCount++] = models[i];
-                            models[i]->setProgenitor(keptModels[k]);
-                        }
-                        i++;
-                    }
-                    for (; i < count; i++) {
-                        mgr->deleteModelFromCache(models[i]);
-                    }
-                    delete[] models;
-                }
-            }
+            //-- models not kept are dropped from the cache, except at the last level
+            driver.setEvict(j + 1 < levels);
+            Model **nextModels = driver.processLevel(j+1, keptModels, keptCount);
             delete[] keptModels;
-            keptCount = width < nextCount ? width : nextCount;
-            keptModels = new Model*[keptCount];
-            printf("models: %d\tkept: %d\n", levelCount, keptCount); fflush(stdout);
-            Report::sort(nextModels, nextCount, mgr->getSortAttr(), Direction::Descending);
-            int i;
-            for (i=0; i < keptCount; i++) {
-                nextModels[i]->setAttribute("level", (double)j+1);
-                nextModels[i]->setID(nextID++);
-                mgr->computeDFStatistics(nextModels[i]);
-                mgr->computeL2Statistics(nextModels[i]);
-                mgr->computeIncrementalAlpha(nextModels[i]);
-                report->addModel(nextModels[i]);
-                keptModels[i] = nextModels[i];
+            keptModels = nextModels;
+            keptCount = driver.getKeptCount();
+            printf("models: %ld\tkept: %ld\n", driver.getSearchedCount(), keptCount); fflush(stdout);
+            for (int i=0; i < keptCount; i++) {
+                keptModels[i]->setID(nextID++);
+                mgr->computeDFStatistics(keptModels[i]);
+                mgr->computeL2Statistics(keptModels[i]);
+                mgr->computeIncrementalAlpha(keptModels[i]);
+                report->addModel(keptModels[i]);
             }
-            delete[] nextModels;
+            if (checkpoint && !driver.writeCheckpoint(checkpoint, j+1, keptModels, keptCount, report))
+                printf("Unable to write checkpoint %s\n", checkpoint);
         }
         delete[] keptModels;
+        //-- the search is finished, so its checkpoint mustn't be resumed
+        if (checkpoint)
+            remove(checkpoint);
 
         report->setAttributes("level$I, h, ddf, lr, alpha, information, aic, bic, incr_alpha, prog_id");
         report->sort("information", Direction::Descending);
@@ -6,10 +6,13 @@
  */
 
 #include "AttributeList.h"
+#include "Key.h"
 #include "OccamMath.h"
 #include "Report.h"
 #include "SBMManager.h"
 #include "SearchBase.h"
+#include "SearchDriver.h"
+#include "Table.h"
 #include "VBMManager.h"
 #include <limits>
 #include <unistd.h>
@@ -66,6 +69,121 @@ DefinePyObject(Relation);
 DefinePyObject(Model);
 DefinePyObject(Report);
 
+//-- a table from the manager, a model or a relation, with the variables for decoding
+//-- its keys. The manager's input and test tables are borrowed (holding a reference to
+//-- the manager, which owns them); other tables can be freed or refitted behind Python's
+//-- back, so the wrapper holds its own copy.
+extern PyTypeObject TTable;
+struct PTable {
+        PyObject_HEAD;
+        Table *obj;
+        VariableList *vars;
+        PyObject *owner; // the manager the table is borrowed from, or NULL if obj is a copy
+};
+static PyObject *newTable(Table *table, VariableList *vars, PyObject *owner);
+
+//-- run one level of a beam search with the given driver, for the managers'
+//-- searchLevel functions. Returns ([models], generated count).
+static PyObject *searchLevel(SearchDriver &driver, SearchBase *search, PyObject *args) {
+    int level, width, descending, evict, incrementalAlpha;
+    PyObject *Pmodels;
+    char *sortName;
+    if (!PyArg_ParseTuple(args, "iO!isiii", &level, &PyList_Type, &Pmodels, &width, &sortName, &descending,
+            &evict, &incrementalAlpha))
+        return NULL;
+    if (search == NULL) {
+        onError("No search method defined");
+    }
+    long oldCount = PyList_Size(Pmodels);
+    Model **oldModels = new Model*[oldCount];
+    for (long i = 0; i < oldCount; i++) {
+        PyObject *Pmodel = PyList_GetItem(Pmodels, i);
+        if (Py_TYPE(Pmodel) != &TModel) {
+            delete[] oldModels;
+            onError("searchLevel requires a list of models");
+        }
+        oldModels[i] = ObjRef(Pmodel, Model);
+    }
+    driver.setWidth(width);
+    driver.setSortAttr(sortName);
+    driver.setSortDirection(descending ? Direction::Descending : Direction::Ascending);
+    driver.setEvict(evict != 0);
+    driver.setIncrementalAlpha(incrementalAlpha != 0);
+    Model **models = driver.processLevel(level, oldModels, oldCount);
+    delete[] oldModels;
+    long count = driver.getKeptCount();
+    PyObject *list = PyList_New(count);
+    for (long i = 0; i < count; i++) {
+        PModel *pmodel = ObjNew(Model);
+        pmodel->obj = models[i];
+        PyList_SetItem(list, i, (PyObject*) pmodel);
+    }
+    delete[] models;
+    //-- the list keeps an extra reference, as in searchOneLevel, since model
+    //-- objects can't be deallocated
+    return Py_BuildValue("(Ol)", list, driver.getGeneratedCount());
+}
+
+//-- checkpoint functions for the managers' writeCheckpoint and readCheckpoint. The
+//-- width and sort settings are those given to searchLevel; the checkpoint is only
+//-- resumed by a search with the same ones.
+//-- writeCheckpoint(path, level, [models], report, width, sortName, descending) returns
+//-- 1 on success, else 0.
+static PyObject *writeCheckpoint(SearchDriver &driver, PyObject *args) {
+    char *path, *sortName;
+    int level, width, descending;
+    PyObject *Pmodels, *Preport;
+    if (!PyArg_ParseTuple(args, "siO!O!isi", &path, &level, &PyList_Type, &Pmodels, &TReport, &Preport, &width,
+            &sortName, &descending))
+        return NULL;
+    driver.setWidth(width);
+    driver.setSortAttr(sortName);
+    driver.setSortDirection(descending ? Direction::Descending : Direction::Ascending);
+    long count = PyList_Size(Pmodels);
+    Model **models = new Model*[count + 1];
+    for (long i = 0; i < count; i++) {
+        PyObject *Pmodel = PyList_GetItem(Pmodels, i);
+        if (Py_TYPE(Pmodel) != &TModel) {
+            delete[] models;
+            onError("writeCheckpoint requires a list of models");
+        }
+        models[i] = ObjRef(Pmodel, Model);
+    }
+    models[count] = NULL;
+    bool ok = driver.writeCheckpoint(path, level, models, count, ObjRef(Preport, Report));
+    delete[] models;
+    return Py_BuildValue("i", ok ? 1 : 0);
+}
+
+//-- readCheckpoint(path, report, width, sortName, descending) returns (level, [kept models],
+//-- last model ID), or None if there is no usable checkpoint.
+static PyObject *readCheckpoint(SearchDriver &driver, PyObject *args) {
+    char *path, *sortName;
+    int width, descending;
+    PyObject *Preport;
+    if (!PyArg_ParseTuple(args, "sO!isi", &path, &TReport, &Preport, &width, &sortName, &descending))
+        return NULL;
+    driver.setWidth(width);
+    driver.setSortAttr(sortName);
+    driver.setSortDirection(descending ? Direction::Descending : Direction::Ascending);
+    int level, lastID;
+    Model **models = driver.readCheckpoint(path, &level, &lastID, ObjRef(Preport, Report));
+    if (models == NULL) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    long count = driver.getKeptCount();
+    PyObject *list = PyList_New(count);
+    for (long i = 0; i < count; i++) {
+        PModel *pmodel = ObjNew(Model);
+        pmodel->obj = models[i];
+        PyList_SetItem(list, i, (PyObject*) pmodel);
+    }
+    delete[] models;
+    //-- the list keeps an extra reference, as in searchLevel
+    return Py_BuildValue("(iOi)", level, list, lastID);
+}
+
 /**************************/
 /****** VBMManager ******/
 /**************************/
@@ -187,6 +305,25 @@ DefinePyFunction(VBMManager, searchOneLevel) {
     return list;
 }
 
+// (Model list, long) searchLevel(level, Model list, width, sortName, descending, evict, incrementalAlpha)
+DefinePyFunction(VBMManager, searchLevel) {
+    VBMManager *mgr = ObjRef(self, VBMManager);
+    SearchDriver driver(mgr);
+    return searchLevel(driver, mgr->getSearch(), args);
+}
+
+// int writeCheckpoint(path, level, Model list, Report report, int width, sortName, int descending)
+DefinePyFunction(VBMManager, writeCheckpoint) {
+    SearchDriver driver(ObjRef(self, VBMManager));
+    return writeCheckpoint(driver, args);
+}
+
+// (int, Model list, int) readCheckpoint(path, Report report, int width, sortName, int descending)
+DefinePyFunction(VBMManager, readCheckpoint) {
+    SearchDriver driver(ObjRef(self, VBMManager));
+    return readCheckpoint(driver, args);
+}
+
 // void setSearchType(const char *name)
 DefinePyFunction(VBMManager, setSearchType) {
     char *name;
@@ -544,6 +681,25 @@ DefinePyFunction(VBMManager, getOptionList) {
     return list;
 }
 
+// Table *getInputTable(), *getTestTable(), *getFitTable() (None if there is none)
+DefinePyFunction(VBMManager, getInputTable) {
+    PyArg_ParseTuple(args, "");
+    VBMManager *mgr = ObjRef(self, VBMManager);
+    return newTable(mgr->getInputData(), mgr->getVariableList(), self);
+}
+
+DefinePyFunction(VBMManager, getTestTable) {
+    PyArg_ParseTuple(args, "");
+    VBMManager *mgr = ObjRef(self, VBMManager);
+    return newTable(mgr->getTestData(), mgr->getVariableList(), self);
+}
+
+DefinePyFunction(VBMManager, getFitTable) {
+    PyArg_ParseTuple(args, "");
+    VBMManager *mgr = ObjRef(self, VBMManager);
+    return newTable(mgr->getFitTable(), mgr->getVariableList(), NULL);
+}
+
 // Model *Report()
 DefinePyFunction(VBMManager, Report) {
     PyArg_ParseTuple(args, "");
@@ -564,6 +720,26 @@ DefinePyFunction(VBMManager, makeFitTable) {
     return Py_None;
 }
 
+// void fitModels(List models)
+DefinePyFunction(VBMManager, fitModels) {
+    PyObject *Pmodels;
+    PyArg_ParseTuple(args, "O!", &PyList_Type, &Pmodels);
+    long count = PyList_Size(Pmodels);
+    Model **models = new Model*[count];
+    for (long i = 0; i < count; i++) {
+        PyObject *Pmodel = PyList_GetItem(Pmodels, i);
+        if (Py_TYPE(Pmodel) != &TModel) {
+            delete[] models;
+            onError("fitModels requires a list of models");
+        }
+        models[i] = ObjRef(Pmodel, Model);
+    }
+    ObjRef(self, VBMManager)->fitModels(models, count);
+    delete[] models;
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 // bool isDirected()
 DefinePyFunction(VBMManager, isDirected) {
     PyArg_ParseTuple(args, "");
@@ -648,6 +824,13 @@ DefinePyFunction(VBMManager, getMemUsage) {
     return Py_BuildValue("d", used);
 }
 
+//double getWorkspacePeakBytes()
+DefinePyFunction(VBMManager, getWorkspacePeakBytes) {
+    PyArg_ParseTuple(args, "");
+    double peak = (double) ObjRef(self, VBMManager)->getWorkspacePeakBytes();
+    return Py_BuildValue("d", peak);
+}
+
 //int hasTestData()
 DefinePyFunction(VBMManager, hasTestData) {
     PyArg_ParseTuple(args, "");
@@ -668,7 +851,9 @@ static struct PyMethodDef VBMManager_methods[] = { PyMethodDef(VBMManager, initF
         PyMethodDef(VBMManager, getDvName),
         PyMethodDef(VBMManager, makeAllChildRelations), PyMethodDef(VBMManager, makeChildModel),
         PyMethodDef(VBMManager, makeModel), PyMethodDef(VBMManager, setFilter),
-        PyMethodDef(VBMManager, searchOneLevel), PyMethodDef(VBMManager, setSearchType),
+        PyMethodDef(VBMManager, searchOneLevel), PyMethodDef(VBMManager, searchLevel),
+        PyMethodDef(VBMManager, writeCheckpoint), PyMethodDef(VBMManager, readCheckpoint),
+        PyMethodDef(VBMManager, setSearchType),
         PyMethodDef(VBMManager, getTopRefModel), PyMethodDef(VBMManager, getBottomRefModel),
         PyMethodDef(VBMManager, getRefModel), PyMethodDef(VBMManager, setRefModel),
         PyMethodDef(VBMManager, computeDF), PyMethodDef(VBMManager, computeH), PyMethodDef(VBMManager, computeT),
@@ -681,13 +866,16 @@ static struct PyMethodDef VBMManager_methods[] = { PyMethodDef(VBMManager, initF
         PyMethodDef(VBMManager, setValuesAreFunctions), PyMethodDef(VBMManager, setSearchDirection),
         PyMethodDef(VBMManager, printFitReport), PyMethodDef(VBMManager, getOption),
         PyMethodDef(VBMManager, getOptionList), PyMethodDef(VBMManager, Report),
-        PyMethodDef(VBMManager, makeFitTable), PyMethodDef(VBMManager, isDirected),
+        PyMethodDef(VBMManager, makeFitTable), PyMethodDef(VBMManager, fitModels),
+        PyMethodDef(VBMManager, isDirected),
         PyMethodDef(VBMManager, printOptions), PyMethodDef(VBMManager, deleteTablesFromCache),
         PyMethodDef(VBMManager, deleteModelFromCache), PyMethodDef(VBMManager, getSampleSz),
         PyMethodDef(VBMManager, printBasicStatistics), PyMethodDef(VBMManager, computePercentCorrect),
         PyMethodDef(VBMManager, printSizes), PyMethodDef(VBMManager, getMemUsage),
+        PyMethodDef(VBMManager, getWorkspacePeakBytes),
         PyMethodDef(VBMManager, hasTestData), PyMethodDef(VBMManager, dumpRelations),
-        PyMethodDef(VBMManager, getVariableList),
+        PyMethodDef(VBMManager, getVariableList), PyMethodDef(VBMManager, getInputTable),
+        PyMethodDef(VBMManager, getTestTable), PyMethodDef(VBMManager, getFitTable),
         { NULL, NULL, 0 } };
 
 /****** Basic Type Operations ******/
@@ -803,6 +991,25 @@ DefinePyFunction(SBMManager, searchOneLevel) {
     return list;
 }
 
+// (Model list, long) searchLevel(level, Model list, width, sortName, descending, evict, incrementalAlpha)
+DefinePyFunction(SBMManager, searchLevel) {
+    SBMManager *mgr = ObjRef(self, SBMManager);
+    SearchDriver driver(mgr);
+    return searchLevel(driver, mgr->getSearch(), args);
+}
+
+// int writeCheckpoint(path, level, Model list, Report report, int width, sortName, int descending)
+DefinePyFunction(SBMManager, writeCheckpoint) {
+    SearchDriver driver(ObjRef(self, SBMManager));
+    return writeCheckpoint(driver, args);
+}
+
+// (int, Model list, int) readCheckpoint(path, Report report, int width, sortName, int descending)
+DefinePyFunction(SBMManager, readCheckpoint) {
+    SearchDriver driver(ObjRef(self, SBMManager));
+    return readCheckpoint(driver, args);
+}
+
 // void setSearchType(const char *name)
 DefinePyFunction(SBMManager, setSearchType) {
     char *name;
@@ -1103,6 +1310,25 @@ DefinePyFunction(SBMManager, getOptionList) {
     return list;
 }
 
+// Table *getInputTable(), *getTestTable(), *getFitTable() (None if there is none)
+DefinePyFunction(SBMManager, getInputTable) {
+    PyArg_ParseTuple(args, "");
+    SBMManager *mgr = ObjRef(self, SBMManager);
+    return newTable(mgr->getInputData(), mgr->getVariableList(), self);
+}
+
+DefinePyFunction(SBMManager, getTestTable) {
+    PyArg_ParseTuple(args, "");
+    SBMManager *mgr = ObjRef(self, SBMManager);
+    return newTable(mgr->getTestData(), mgr->getVariableList(), self);
+}
+
+DefinePyFunction(SBMManager, getFitTable) {
+    PyArg_ParseTuple(args, "");
+    SBMManager *mgr = ObjRef(self, SBMManager);
+    return newTable(mgr->getFitTable(), mgr->getVariableList(), NULL);
+}
+
 // Model *Report()
 DefinePyFunction(SBMManager, Report) {
     PyArg_ParseTuple(args, "");
@@ -1188,6 +1414,13 @@ DefinePyFunction(SBMManager, getMemUsage) {
     return Py_BuildValue("d", used);
 }
 
+//double getWorkspacePeakBytes()
+DefinePyFunction(SBMManager, getWorkspacePeakBytes) {
+    PyArg_ParseTuple(args, "");
+    double peak = (double) ObjRef(self, SBMManager)->getWorkspacePeakBytes();
+    return Py_BuildValue("d", peak);
+}
+
 //long printBasicStatistics()
 DefinePyFunction(SBMManager, printBasicStatistics) {
     PyArg_ParseTuple(args, "");
@@ -1207,7 +1440,9 @@ DefinePyFunction(SBMManager, hasTestData) {
 }
 
 static struct PyMethodDef SBMManager_methods[] = { PyMethodDef(SBMManager, initFromCommandLine),
-        PyMethodDef(SBMManager, searchOneLevel), PyMethodDef(SBMManager, makeSbModel),
+        PyMethodDef(SBMManager, searchOneLevel), PyMethodDef(SBMManager, searchLevel),
+        PyMethodDef(SBMManager, writeCheckpoint), PyMethodDef(SBMManager, readCheckpoint),
+        PyMethodDef(SBMManager, makeSbModel),
         PyMethodDef(SBMManager, setFilter), PyMethodDef(SBMManager, setSearchType),
         PyMethodDef(SBMManager, getTopRefModel), PyMethodDef(SBMManager, getBottomRefModel),
         PyMethodDef(SBMManager, getRefModel), PyMethodDef(SBMManager, setRefModel),
@@ -1222,7 +1457,10 @@ static struct PyMethodDef SBMManager_methods[] = { PyMethodDef(SBMManager, initF
         PyMethodDef(SBMManager, isDirected), PyMethodDef(SBMManager, printOptions),
         PyMethodDef(SBMManager, deleteModelFromCache), PyMethodDef(SBMManager, deleteTablesFromCache),
         PyMethodDef(SBMManager, computePercentCorrect), PyMethodDef(SBMManager, getSampleSz), PyMethodDef(SBMManager, getMemUsage),
-        PyMethodDef(SBMManager, printBasicStatistics), PyMethodDef(SBMManager, hasTestData), { NULL, NULL, 0 } };
+        PyMethodDef(SBMManager, getWorkspacePeakBytes),
+        PyMethodDef(SBMManager, printBasicStatistics), PyMethodDef(SBMManager, hasTestData),
+        PyMethodDef(SBMManager, getInputTable), PyMethodDef(SBMManager, getTestTable),
+        PyMethodDef(SBMManager, getFitTable), { NULL, NULL, 0 } };
 
 /****** Basic Type Operations ******/
 static void SBMManager_dealloc(PSBMManager *self) {
@@ -1298,7 +1536,15 @@ DefinePyFunction(Relation, get) {
     return PyFloat_FromDouble(value);
 }
 
-static struct PyMethodDef Relation_methods[] = { PyMethodDef(Relation, get), { NULL, NULL, 0 } };
+// Table *getTable() - the projection of the data (None if not made)
+DefinePyFunction(Relation, getTable) {
+    PyArg_ParseTuple(args, "");
+    Relation *relation = ObjRef(self, Relation);
+    return newTable(relation->getTable(), relation->getVariableList(), NULL);
+}
+
+static struct PyMethodDef Relation_methods[] = { PyMethodDef(Relation, get), PyMethodDef(Relation, getTable), { NULL,
+        NULL, 0 } };
 
 /****** Basic Type Operations ******/
 
@@ -1488,10 +1734,19 @@ DefinePyFunction(Model, dump) {
     return Py_None;
 }
 
+// Table *getFitTable() - the model's own fit table (None if not kept)
+DefinePyFunction(Model, getFitTable) {
+    PyArg_ParseTuple(args, "");
+    Model *model = ObjRef(self, Model);
+    Table *table = model->getFitTable();
+    return newTable(table, table ? model->getRelation(0)->getVariableList() : NULL, NULL);
+}
+
 static struct PyMethodDef Model_methods[] = { PyMethodDef(Model, getRelation), PyMethodDef(Model, get),
         PyMethodDef(Model, deleteFitTable), PyMethodDef(Model, deleteRelationLinks),
         PyMethodDef(Model, setProgenitor), PyMethodDef(Model, getProgenitor), PyMethodDef(Model, setID),
-        PyMethodDef(Model, isEquivalentTo), PyMethodDef(Model, dump), { NULL, NULL, 0 } };
+        PyMethodDef(Model, isEquivalentTo), PyMethodDef(Model, dump), PyMethodDef(Model, getFitTable), { NULL,
+                NULL, 0 } };
 
 /****** Basic Type Operations ******/
 
@@ -1909,6 +2164,224 @@ PyTypeObject TReport = { PyObject_HEAD_INIT(&PyType_Type) 0, "Report", sizeof(PR
         (setattrofunc) 0,
     };
 
+/************************/
+/****** Table ******/
+/************************/
+
+/*
+ * Tables are exposed as arrays through the buffer protocol, so they can be used with
+ * numpy.asarray (or memoryview) without copying or formatting each tuple:
+ *   keys()   - the keys, (tuples x key segments) of unsigned long
+ *   values() - the values, (tuples) of double
+ *   states() - each tuple's value index for each variable, (tuples x variables) of int,
+ *              with -1 for variables not in the key
+ * keys and values are views of the Table object's storage (strided, for interleaved
+ * tables), and keep it alive; states is a copy. Input and test tables don't change once
+ * read; fit tables and projections are copied when their Table object is made, so later
+ * fits, or deleting the model's or relation's table, don't change the arrays.
+ */
+struct PTableArray {
+        PyObject_HEAD;
+        PyObject *owner; // the Table whose storage this is, or NULL if buf is our own
+        char *buf;
+        int ndim;
+        Py_ssize_t shape[2];
+        Py_ssize_t strides[2];
+        Py_ssize_t itemsize;
+        char *format;
+};
+
+extern PyTypeObject TTableArray;
+
+static PyObject *newTableArray(PyObject *owner, void *buf, const char *format, Py_ssize_t itemsize,
+        Py_ssize_t rows, Py_ssize_t rowStride, Py_ssize_t columns = 0) {
+    PTableArray *array = PyObject_NEW(PTableArray, &TTableArray);
+    if (array == NULL)
+        return NULL;
+    Py_XINCREF(owner);
+    array->owner = owner;
+    array->buf = (char*) buf;
+    array->format = (char*) format;
+    array->itemsize = itemsize;
+    array->shape[0] = rows;
+    array->strides[0] = rowStride;
+    array->ndim = columns > 0 ? 2 : 1;
+    array->shape[1] = columns;
+    array->strides[1] = itemsize;
+    return (PyObject*) array;
+}
+
+static void TableArray_dealloc(PTableArray *self) {
+    if (self->owner)
+        Py_DECREF(self->owner);
+    else
+        delete[] self->buf;
+    PyObject_DEL(self);
+}
+
+static int TableArray_getbuffer(PyObject *self, Py_buffer *view, int flags) {
+    PTableArray *array = (PTableArray*) self;
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "table arrays are read-only");
+        return -1;
+    }
+    Py_ssize_t rowBytes = array->ndim == 2 ? array->shape[1] * array->itemsize : array->itemsize;
+    if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES && array->strides[0] != rowBytes && array->shape[0] > 1) {
+        PyErr_SetString(PyExc_BufferError, "table array is not contiguous");
+        return -1;
+    }
+    view->obj = self;
+    Py_INCREF(self);
+    view->buf = array->buf;
+    view->len = array->shape[0] * rowBytes;
+    view->readonly = 1;
+    view->itemsize = array->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? array->format : NULL;
+    view->ndim = array->ndim;
+    view->shape = (flags & PyBUF_ND) ? array->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? array->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PyBufferProcs TableArray_as_buffer = { 0, 0, 0, 0, (getbufferproc) TableArray_getbuffer, 0 };
+
+PyTypeObject TTableArray = { PyObject_HEAD_INIT(&PyType_Type) 0, "TableArray", sizeof(PTableArray), 0,
+//-- standard methods
+        (destructor) TableArray_dealloc,
+        (printfunc) 0,
+        (getattrfunc) 0,
+        (setattrfunc) 0,
+        (cmpfunc) 0,
+        (reprfunc) 0,
+
+        //-- type categories
+        0,
+        0,
+        0,
+
+        //-- more methods
+        (hashfunc) 0,
+        (ternaryfunc) 0,
+        (reprfunc) 0,
+        (getattrofunc) 0,
+        (setattrofunc) 0,
+        &TableArray_as_buffer,
+        Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER,
+    };
+
+static PyObject *newTable(Table *table, VariableList *vars, PyObject *owner) {
+    if (table == NULL) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    PTable *newobj = PyObject_NEW(PTable, &TTable);
+    if (newobj == NULL)
+        return NULL;
+    if (owner) {
+        Py_INCREF(owner);
+        newobj->obj = table;
+    } else {
+        newobj->obj = new Table(table->getKeySize(), table->getTupleCount() > 0 ? table->getTupleCount() : 1,
+                TableType::InformationTheoretic, table->getLayout());
+        newobj->obj->copy(table);
+    }
+    newobj->vars = vars;
+    newobj->owner = owner;
+    return (PyObject*) newobj;
+}
+
+// TableArray keys()
+DefinePyFunction(Table, keys) {
+    PyArg_ParseTuple(args, "");
+    Table *table = ObjRef(self, Table);
+    return newTableArray(self, table->getKeyArray(), "L", sizeof(KeySegment), table->getTupleCount(),
+            table->getKeyStride() * sizeof(KeySegment), table->getKeySize());
+}
+
+// TableArray values()
+DefinePyFunction(Table, values) {
+    PyArg_ParseTuple(args, "");
+    Table *table = ObjRef(self, Table);
+    return newTableArray(self, table->getValueArray(), "d", sizeof(ocTupleValue), table->getTupleCount(),
+            table->getValueStride() * sizeof(ocTupleValue));
+}
+
+// TableArray states()
+DefinePyFunction(Table, states) {
+    PyArg_ParseTuple(args, "");
+    Table *table = ObjRef(self, Table);
+    VariableList *vars = ((PTable*) self)->vars;
+    long long count = table->getTupleCount();
+    int varCount = vars->getVarCount();
+    int keysize = table->getKeySize();
+    //-- the array frees its buffer as char[]
+    int *states = (int*) new char[(count * varCount > 0 ? count * varCount : 1) * sizeof(int)];
+    for (long long i = 0; i < count; i++) {
+        KeySegment *key = table->getKey(i);
+        for (int j = 0; j < varCount; j++) {
+            Variable *var = vars->getVariable(j);
+            int value = Key::getKeyValue(key, keysize, vars, j);
+            states[i * varCount + j] = value == (int) (var->mask >> var->shift) ? -1 : value;
+        }
+    }
+    return newTableArray(NULL, states, "i", sizeof(int), count, varCount * sizeof(int), varCount);
+}
+
+static struct PyMethodDef Table_methods[] = { PyMethodDef(Table, keys), PyMethodDef(Table, values),
+        PyMethodDef(Table, states), { NULL, NULL, 0 } };
+
+/****** Basic Type Operations ******/
+
+static void Table_dealloc(PTable *self) {
+    if (self->owner)
+        Py_DECREF(self->owner);
+    else
+        delete self->obj;
+    PyObject_DEL(self);
+}
+
+PyObject * Table_getattr(PyObject *self, char *name) {
+    PyObject *method = Py_FindMethod(Table_methods, self, name);
+    if (method)
+        return method;
+    PyErr_Clear();
+
+    Table *table = ObjRef(self, Table);
+    if (strcmp(name, "size") == 0)
+        return PyLong_FromLongLong(table->getTupleCount());
+    if (strcmp(name, "keysize") == 0)
+        return PyInt_FromLong(table->getKeySize());
+    if (strcmp(name, "varcount") == 0)
+        return PyInt_FromLong(((PTable*) self)->vars->getVarCount());
+    PyErr_SetString(PyExc_AttributeError, name);
+    return NULL;
+}
+
+/****** Type Definition ******/
+PyTypeObject TTable = { PyObject_HEAD_INIT(&PyType_Type) 0, "Table", sizeof(PTable), 0,
+//-- standard methods
+        (destructor) Table_dealloc,
+        (printfunc) 0,
+        (getattrfunc) Table_getattr,
+        (setattrfunc) 0,
+        (cmpfunc) 0,
+        (reprfunc) 0,
+
+        //-- type categories
+        0,
+        0,
+        0,
+
+        //-- more methods
+        (hashfunc) 0,
+        (ternaryfunc) 0,
+        (reprfunc) 0,
+        (getattrofunc) 0,
+        (setattrofunc) 0,
+    };
+
 /**************************/
 /****** MODULE LOGIC ******/
 /**************************/
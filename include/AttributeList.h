@@ -26,6 +26,7 @@ class AttributeList {
         int getAttributeIndex(const char *name);
         int getAttributeCount();
         double getAttributeByIndex(int index);
+        const char *getAttributeName(int index);
 
         // Print out values
         void dump();
@@ -18,4 +18,10 @@ extern class Table* sort_table;
 
 int sortKeys(const void*, const void*);
 
+//-- sort an index array into the same order sortKeys would produce, using a counting
+//-- sort per variable rather than qsort. keys is used if not null, otherwise the table.
+//-- vars lists the variables to sort on (null means the first var_count variables).
+void sortKeyOrder(int *order, long long count, class VariableList *varlist, int var_count,
+                  int *vars, KeySegment **keys, class Table *table);
+
 #endif
@@ -16,6 +16,8 @@
  * oldRead - read data from old format files. The Table and VariableList are allocated
  * in this function, and then populated with the input data and the variables, respectively
  * The return value is the number of data lines read.
+ * The file may instead be a data cache, as written when the "data-cache-file" option is
+ * set; it is loaded directly, and the return value is that of the original read.
  */
 
 int ocReadFile(FILE *fd, class Options *options,
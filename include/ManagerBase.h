@@ -53,6 +53,29 @@ class ocIntersectProcessor {
 using std::map;
 typedef map<Relation*, long long> FitIntersectMap;
 
+/**
+ * FitWorkspace - the tables and scratch arrays an IPF fit works in. The scratch
+ * arrays only grow, to the largest fit seen so far, so a workspace is kept and
+ * reused from one fit to the next. The manager borrows its own fit tables into
+ * one for each serial fit; parallel fits get one workspace per thread.
+ */
+class FitWorkspace {
+    public:
+        FitWorkspace();
+        ~FitWorkspace();    // deletes any tables it still holds
+        long long size();   // bytes held by the tables and scratch arrays
+
+        Table *fitTable1;
+        Table *fitTable2;
+        Table *projTable;
+        int *ipfCells;
+        long long ipfCellsCapacity;
+        double *ipfMarginals;
+        long long ipfMarginalsCapacity;
+        double *ipfHistory;
+        long long ipfHistoryCapacity;
+};
+
 class ManagerBase {
     public:
         // method to use for computing H. Auto means use IPF if there are loops and
@@ -121,6 +144,12 @@ class ManagerBase {
         virtual bool makeFitTableIPF(Model *model);
         virtual bool makeFitTableAlgebraic(Model *model);
 
+        // Fit a batch of models (typically the new models of a search level) with
+        // search-threads threads, leaving each looped model's fitted H set, so that
+        // computing its statistics afterwards does not fit it again. Models without
+        // loops, state-based models, and models already fitted are left alone.
+        void fitModels(Model **models, long count);
+
         // Expand a single tuple into all values of all missing variables, recursively
         void expandTuple(double tupleValue, KeySegment *key, int *missingVars, int missingCount, Table *outTable,
                 int currentMissingVar);
@@ -137,6 +166,10 @@ class ManagerBase {
         // it isn't correct if the model contains loops. For models with loops, use IPF.
         void calculateDfAndEntropy(Model *model);
 
+        // The same, from the DF and H of another model (typically the model's
+        // progenitor), adjusting them for only the relations which differ.
+        void calculateDfAndEntropy(Model *model, Model *progenitor);
+
         // Determine if the model has loops, and cache this fact for later use
         bool hasLoops(Model *model);
 
@@ -164,6 +197,15 @@ class ManagerBase {
         void setSearchDirection(Direction dir);
         Direction getSearchDirection() { return searchDirection; }
 
+        // true if fits can start from a progenitor's fit: ipf-warm-start is on and the
+        // search is upward (a model contains its progenitor only when searching up)
+        bool isWarmStarting();
+        // while set, each fitted model keeps a copy of its fit, for warm starts. The
+        // search driver sets it for the models of a level, which may become progenitors.
+        void setKeepFits(bool flag) {
+            keepFits = flag;
+        }
+
         double computeDfSb(Model *model);
 
         virtual Model *getTopRefModel() {
@@ -258,6 +300,11 @@ class ManagerBase {
         //-- Print debug info on memory usage
         void printSizes();
 
+        //-- the most memory (in bytes) the fit work tables and IPF scratch space have used
+        long long getWorkspacePeakBytes() {
+            return workspacePeakBytes;
+        }
+
         //-- print out all relations
         void dumpRelations();
         double alpha_threshold = 0.05;
@@ -273,6 +320,37 @@ class ManagerBase {
         Model* projectedModel(Relation* projectTo, Model* model);
 
     protected:
+        // the nonempty intersections of rels with rel, without any contained in another
+        int projectRelations(Relation **rels, int count, Relation *rel, Relation **proj);
+        // add sign times the inclusion-exclusion sums of DF and H over rels to df and h
+        void addIntersectionTerms(Relation **rels, int count, double sign, double &df, double &h);
+        // project t1 into t2 through a direct-indexed array of the relation's nc cells.
+        // Returns false (leaving t2 empty) if some key holds a value outside a variable's
+        // cardinality, in which case the caller falls back to the hashed projection.
+        bool makeDenseProjection(Table *t1, Table *t2, Relation *rel, long long nc);
+
+        // the IPF fit of a model in the given workspace, leaving the result in its
+        // fitTable1. Only reads shared state, so threads can run it on different models
+        // once the models' projections exist.
+        bool fitIPF(Model *model, FitWorkspace &work, int ipfThreads);
+
+        // the IPF iterations for a variable-based model, starting from work.fitTable1, using
+        // precomputed marginal indices. Sets the final error and returns the iteration count.
+        // With ipf-accel, every third sweep is followed by an extrapolation step.
+        int scaleIndexedIPF(FitWorkspace &work, int relCount, Table **tableList, KeySegment **maskList,
+                double maxiter, double delta2, double &error, int ipfThreads);
+
+        // with ipf-warm-start, keep a copy of a model's fit to seed its descendants' fits
+        void keepFit(Model *model, Table *fit);
+
+        // fit work space: the scratch for the manager's own fits (its tables stay in
+        // fitTable1, fitTable2 and projTable), and a pool of workspaces for fitModels.
+        FitWorkspace ipfWork;
+        FitWorkspace **threadWork;
+        int threadWorkCount;
+        long long workspacePeakBytes;
+        void updateWorkspacePeak();
+
         Model *topRef;
         Model *bottomRef;
         Model *refModel;
@@ -293,13 +371,12 @@ class ManagerBase {
         int dataLines;
         int *DVOrder;
         int useInverseNotation;
-        VarIntersect *intersectArray;
-        int intersectCount;
-        int intersectMax;
+        VarIntersectLevel intersectLevels[2]; // workspace for doIntersectionProcessing
         double functionConstant;
         double negativeConstant;
         bool valuesAreFunctions;
         Direction searchDirection;
+        bool keepFits;
 
 
 };
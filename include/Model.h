@@ -47,6 +47,17 @@ class Model {
         // get a printable name for the relation, using the variable abbreviations
         const char *getPrintName(int useInverse = 0);
 
+        // get the fingerprint of the model's relations (see ModelCache.h)
+        ModelFingerprint getFingerprint();
+
+        // the fingerprint a model with exactly these relations would have
+        static ModelFingerprint fingerprint(Relation **rels, int count);
+
+        // reduce a list of relations to what addRelation would keep: drop duplicates
+        // and any relation contained in another. Returns the new count. Relations
+        // stay in their original order.
+        static int normalizeRelations(Relation **rels, int count);
+
         // set, get hash chain linkages
         Model *getHashNext() {
             return hashNext;
@@ -108,6 +119,8 @@ class Model {
         Model *hashNext;
         char *printName;
         char *inverseName;
+        ModelFingerprint print;
+        bool hasFingerprint;
         int **structMatrix;
         long totalConstraints;
         int stateSpaceSize;
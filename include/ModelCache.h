@@ -8,15 +8,27 @@
 #ifndef ___ModelCache
 #define ___ModelCache
 
+#include "NameCache.h"
+
+/**
+ * ModelFingerprint - a 128-bit, order-independent hash of a model's relations: the
+ * sum, word by word, of the relations' fingerprints. Equal sets of relations give
+ * equal fingerprints however they are ordered, so a search can look a model up
+ * from its relation list before building the model or its name.
+ */
+struct ModelFingerprint {
+    unsigned long long a, b;
+};
+
 /**
  * ModelCache.h - defines the model cache.  This provides a way to reuse model
  * objects.
  * the cache matches on the printName for the model, which uniquely identifies the
- * set of relations.
+ * set of relations. A second index matches on the model's fingerprint.
  * There must be a separate model cache for each different problem instance.
+ * The cache can be searched, added to and deleted from by several threads at once.
  *
  */
-#define MODELCACHE_HASHSIZE 1001
 class ModelCache {
     public:
 	//-- construct an empty model cache
@@ -31,6 +43,16 @@ class ModelCache {
 	//-- exists, an error is returned.
 	bool addModel(class Model *model);
 
+	//-- findOrAddModel - add a model unless a matching one is already cached, as
+	//-- one step. Returns the cached model, which is model if it was added.
+	class Model *findOrAddModel(class Model *model);
+
+	//-- findOrAddModel - get the model made of these variable-based relations,
+	//-- normalized as addRelation would. The cache is probed by fingerprint first,
+	//-- and a model is only built if none is found. The list is normalized in place.
+	//-- fromCache, if given, is set to whether the model was already cached.
+	class Model *findOrAddModel(class Relation **rels, int count, bool *fromCache = 0);
+
 	//-- deleteModel - deletes a model from the cache.
 	//-- returns true if successful, false if not found.
 	bool deleteModel(class Model *model);
@@ -39,10 +61,30 @@ class ModelCache {
 	//-- model doesn't exist.
 	class Model *findModel(const char *name);
 
+	//-- findModel - find the model with exactly these relations, by fingerprint.
+	//-- The list must already be normalized (see Model::normalizeRelations).
+	//-- Null is returned if there is no such model in the cache.
+	class Model *findModel(class Relation **rels, int count);
+
 	void dump();
 
     private:
-	class Model **hash;
+	NameCache<class Model> hash;
+
+	//-- fingerprint index, open addressing in sharded, growable slot arrays.
+	//-- Deleted models leave tombstones, which are dropped when a shard is rebuilt.
+	struct PrintShard {
+	    std::mutex lock;
+	    class Model **slots;
+	    unsigned long long *codes;
+	    long slotCount;       // a power of two
+	    long itemCount;
+	    long usedCount;       // items plus tombstones
+	};
+	PrintShard printShards[NAMECACHE_SHARDS];
+	void addPrint(class Model *model);
+	void removePrint(class Model *model);
+	void rebuildPrints(PrintShard &shard, long newCount);
 };
 
 #endif
@@ -0,0 +1,178 @@
+/*
+ * Copyright © 1990 The Portland State University OCCAM Project Team
+ * [This program is licensed under the GPL version 3 or later.]
+ * Please see the file LICENSE in the source
+ * distribution of this software for license terms.
+ */
+
+#ifndef ___NameCache
+#define ___NameCache
+
+#include <mutex>
+#include <string.h>
+
+/**
+ * NameCache.h - the hash table behind RelCache and ModelCache. Items (relations or
+ * models) are chained through their own hashNext links, and matched on their print
+ * names. The table is split into shards, each with its own lock and bucket array, so
+ * threads working in different shards don't wait on each other. A shard doubles its
+ * buckets whenever it holds more items than buckets, keeping chains short however
+ * many items a search creates.
+ *
+ * An item's print name is built before the item is linked in, so the names in the
+ * table are never changed while other threads can see them.
+ */
+#define NAMECACHE_SHARDS 64
+#define NAMECACHE_START_BUCKETS 16
+
+template <class T> class NameCache {
+    public:
+        NameCache() {
+            for (int s = 0; s < NAMECACHE_SHARDS; s++) {
+                shards[s].buckets = new T*[NAMECACHE_START_BUCKETS];
+                memset(shards[s].buckets, 0, NAMECACHE_START_BUCKETS * sizeof(T*));
+                shards[s].bucketCount = NAMECACHE_START_BUCKETS;
+                shards[s].itemCount = 0;
+            }
+        }
+
+        //-- the items are not deleted; the owning cache does that
+        ~NameCache() {
+            for (int s = 0; s < NAMECACHE_SHARDS; s++) {
+                delete[] shards[s].buckets;
+            }
+        }
+
+        //-- find an item by name. Null is returned if there is none.
+        T *find(const char *name) {
+            unsigned long long code = hashName(name);
+            Shard &shard = shardOf(code);
+            std::lock_guard<std::mutex> guard(shard.lock);
+            return findIn(shard, code, name);
+        }
+
+        //-- add an item, unless one with the same name is there already. Returns the
+        //-- item now in the table: either this one, or the one found.
+        T *findOrAdd(T *item) {
+            const char *name = item->getPrintName();
+            unsigned long long code = hashName(name);
+            Shard &shard = shardOf(code);
+            std::lock_guard<std::mutex> guard(shard.lock);
+            T *found = findIn(shard, code, name);
+            if (found)
+                return found;
+            if (shard.itemCount >= shard.bucketCount)
+                grow(shard);
+            T *&bucket = shard.buckets[code & (shard.bucketCount - 1)];
+            item->setHashNext(bucket);
+            bucket = item;
+            shard.itemCount++;
+            return item;
+        }
+
+        //-- unlink an item. Returns false if it was not in the table.
+        bool remove(T *item) {
+            unsigned long long code = hashName(item->getPrintName());
+            Shard &shard = shardOf(code);
+            std::lock_guard<std::mutex> guard(shard.lock);
+            T *&bucket = shard.buckets[code & (shard.bucketCount - 1)];
+            T *rp = bucket;
+            T *prev = NULL;
+            while (rp && rp != item) {
+                prev = rp;
+                rp = rp->getHashNext();
+            }
+            if (rp == NULL)
+                return false;
+            if (prev == NULL)
+                bucket = item->getHashNext();
+            else
+                prev->setHashNext(item->getHashNext());
+            shard.itemCount--;
+            return true;
+        }
+
+        //-- call visit(item) for every item. The next link is read before each call,
+        //-- so visit may delete the item. Not to be used while other threads add or remove.
+        template <class Visit> void forEach(Visit visit) {
+            for (int s = 0; s < NAMECACHE_SHARDS; s++) {
+                Shard &shard = shards[s];
+                for (long b = 0; b < shard.bucketCount; b++) {
+                    T *item = shard.buckets[b];
+                    while (item) {
+                        T *next = item->getHashNext();
+                        visit(item);
+                        item = next;
+                    }
+                }
+            }
+        }
+
+        //-- memory used by the bucket arrays
+        long size() {
+            long bytes = sizeof(*this);
+            for (int s = 0; s < NAMECACHE_SHARDS; s++) {
+                bytes += shards[s].bucketCount * sizeof(T*);
+            }
+            return bytes;
+        }
+
+        long count() {
+            long items = 0;
+            for (int s = 0; s < NAMECACHE_SHARDS; s++) {
+                items += shards[s].itemCount;
+            }
+            return items;
+        }
+
+    private:
+        struct Shard {
+            std::mutex lock;
+            T **buckets;
+            long bucketCount;     // a power of two
+            long itemCount;
+        };
+        Shard shards[NAMECACHE_SHARDS];
+
+        //-- FNV-1a. The top bits pick the shard, the low bits the bucket.
+        static unsigned long long hashName(const char *name) {
+            unsigned long long code = 14695981039346656037ULL;
+            for (const char *cp = name; *cp; cp++) {
+                code ^= (unsigned char) *cp;
+                code *= 1099511628211ULL;
+            }
+            return code;
+        }
+
+        Shard &shardOf(unsigned long long code) {
+            return shards[code >> 58];
+        }
+
+        T *findIn(Shard &shard, unsigned long long code, const char *name) {
+            T *item = shard.buckets[code & (shard.bucketCount - 1)];
+            while (item && strcmp(name, item->getPrintName()) != 0)
+                item = item->getHashNext();
+            return item;
+        }
+
+        void grow(Shard &shard) {
+            long newCount = shard.bucketCount * 2;
+            T **newBuckets = new T*[newCount];
+            memset(newBuckets, 0, newCount * sizeof(T*));
+            for (long b = 0; b < shard.bucketCount; b++) {
+                T *item = shard.buckets[b];
+                while (item) {
+                    T *next = item->getHashNext();
+                    T *&bucket = newBuckets[hashName(item->getPrintName()) & (newCount - 1)];
+                    item->setHashNext(bucket);
+                    bucket = item;
+                    item = next;
+                }
+            }
+            delete[] shard.buckets;
+            shard.buckets = newBuckets;
+            shard.bucketCount = newCount;
+        }
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * Copyright © 1990 The Portland State University OCCAM Project Team
+ * [This program is licensed under the GPL version 3 or later.]
+ * Please see the file LICENSE in the source
+ * distribution of this software for license terms.
+ */
+
+#ifndef ___Parallel
+#define ___Parallel
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+/**
+ * Barrier - blocks each of a fixed number of threads in wait() until all of them
+ * have arrived. It can be reused for any number of phases.
+ */
+class Barrier {
+    public:
+        Barrier(int threads);
+        void wait();
+
+    private:
+        std::mutex lock;
+        std::condition_variable released;
+        int threadCount;
+        int waiting;
+        long generation;
+};
+
+/**
+ * ocThreadCount - resolve a requested thread count. Zero (or less) means one thread
+ * per available core. The count is further limited so that each thread gets at least
+ * minWork of the given work units.
+ */
+int ocThreadCount(int requested, long long work = 0, long long minWork = 1);
+
+/**
+ * ocRunThreads - run body(t) for t = 0..threadCount-1, each on its own thread (t = 0
+ * runs on the calling thread), and return when all of them have finished.
+ */
+void ocRunThreads(int threadCount, const std::function<void(int)> &body);
+
+#endif
@@ -8,6 +8,9 @@
 #ifndef ___RelationCache
 #define ___RelationCache
 
+#include "NameCache.h"
+#include "Types.h"
+
 /**
  * RelCache.h - defines the relation cache.  This provides a way to reuse relation
  * objects, since once constructed a relation object can be used by any model
@@ -15,9 +18,9 @@
  * the cache matches on the mask for the relation, which uniquely identifies the
  * set of variables in the relation.
  * There must be a separate relation cache for each different problem instance.
+ * The cache can be searched and added to from several threads at once.
  *
  */
-#define RELCACHE_HASHSIZE 1001
 class RelCache {
     public:
 	//-- construct an empty relation cache
@@ -28,21 +31,43 @@ class RelCache {
 
 	long size();
 
-	//-- delete projection tables from all relations in cache
-	void deleteTables();
+	//-- delete projection tables from all relations in cache, except the given
+	//-- table (the input data, which the saturated relation uses as its projection)
+	void deleteTables(class Table *keep = NULL);
 
 	//-- addRelation - put a new relation in the cache. If a matching relation already
 	//-- exists, an error is returned.
 	bool addRelation(class Relation *rel);
 
+	//-- findOrAddRelation - add a relation unless a matching one is already cached,
+	//-- as one step. Returns the cached relation, which is rel if it was added.
+	class Relation *findOrAddRelation(class Relation *rel);
+
 	//-- findRelation - find a relation in the cache.  Null is returned if the given
 	//-- relation doesn't exist.
 	class Relation *findRelation(const char *name);
 
+	//-- findRelation - find a variable-based relation by its mask (see Key::buildMask),
+	//-- without building a relation or its name. Null is returned if it isn't cached.
+	class Relation *findRelation(const KeySegment *mask, int keysize);
+
 	void dump();
 
     private:
-	class Relation **hash;
+	NameCache<class Relation> hash;
+
+	//-- second index over the variable-based relations, keyed by mask. Open addressing
+	//-- in sharded, growable slot arrays; relations are only ever added to it.
+	struct MaskShard {
+	    std::mutex lock;
+	    class Relation **slots;
+	    unsigned long long *codes;
+	    long slotCount;       // a power of two
+	    long itemCount;
+	};
+	MaskShard maskShards[NAMECACHE_SHARDS];
+	void addMask(class Relation *rel);
+	void growMasks(MaskShard &shard);
 };
 
 #endif
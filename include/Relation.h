@@ -9,6 +9,7 @@
 #define ___Relation
 
 #include "Table.h"
+#include "VarSet.h"
 #include "VariableList.h"
 
 /*
@@ -81,6 +82,14 @@ class Relation {
         // see if one relation contains another
         bool contains(Relation *other);
 
+        // get the variables as a bitset (built on first use), for fast containment
+        // and intersection tests between variable-based relations
+        const VarSet &getVarSet() {
+            if (varSet == NULL)
+                buildVarSet();
+            return *varSet;
+        }
+
         // see if all variables are independent or all dependent
         bool isIndependentOnly();
         bool isDependentOnly();
@@ -94,6 +103,10 @@ class Relation {
         void makeMask(KeySegment *msk);
         KeySegment *getMask();
 
+        // get a 128-bit hash of the relation's variables (and states, if state-based),
+        // as two words. Models combine these into their fingerprints (see ModelCache.h).
+        const unsigned long long *getFingerprint();
+
         // get the key size; a convenience function for getting it from the variable list
         int getKeySize() {
             return varList->getKeySize();
@@ -131,6 +144,8 @@ class Relation {
 
     private:
         void buildMask(); // build the variable mask from the list of variables
+        void buildFingerprint();
+        void buildVarSet();
 
         VariableList *varList; // variable list associated with this relation
         int *vars; // array of variable indices
@@ -142,6 +157,9 @@ class Relation {
         class StateConstraint *stateConstraints; // state constraints
         Relation *hashNext; // linkage for storing relations in a hash table
         KeySegment *mask; // mask has zero for variables in this rel, 1's elsewhere
+        VarSet *varSet; // the same variables as vars, as a bitset
+        unsigned long long fingerprint[2];
+        bool hasFingerprint;
         class AttributeList *attributeList;
         char *printName;
         char *inverseName;
@@ -54,6 +54,8 @@ class Report {
 	//-- Add a model to the list of models. The model is added at the end. Run sort() after
 	//-- all models are added to sort them.
 	void addModel(class Model *model);
+	long getModelCount() { return modelCount; }
+	class Model *getModel(long index) { return models[index]; }
 
 	void setDefaultFitModel(class Model *model);
 
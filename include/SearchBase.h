@@ -23,16 +23,19 @@ class SearchBase {
     bool isDirected() { return directed; }
     bool makeProjection() { return projection; }
     ManagerBase *getManager() { return manager; }
+    const char *getName() { return name; }	// the search type name it was made from
 
     protected:
     void setManager(ManagerBase *mgr) { manager = mgr; }
     void setDirected(bool dir) { directed = dir; }
     void setMakeProjection(bool proj) { projection = proj; }
+    void setName(const char *typeName) { name = typeName; }
 
     //-- data
     ManagerBase *manager;
     bool directed;	// system is directed (has dependent variables)
     bool projection; // create a projection table for all new relations
+    const char *name;	// static string from the search type table
 };
 
 class SearchFactory {
@@ -0,0 +1,121 @@
+/*
+ * Copyright © 1990 The Portland State University OCCAM Project Team
+ * [This program is licensed under the GPL version 3 or later.]
+ * Please see the file LICENSE in the source
+ * distribution of this software for license terms.
+ */
+
+#ifndef ___SearchDriver
+#define ___SearchDriver
+
+#include "Types.h"
+#include <string>
+#include <vector>
+
+class Model;
+class SearchBase;
+class ManagerBase;
+class VBMManager;
+class SBMManager;
+class Report;
+
+/**
+ * SearchDriver - runs a beam search one level at a time. Each level takes the models
+ * kept from the previous level, generates their neighbors with the manager's search
+ * object, fits and scores the new ones, and keeps the best "width" of them, ranked on
+ * the sort attribute (ties go to the alphabetically first name).
+ *
+ * A model is scored only the first time any search level generates it; the model
+ * cache returns the same object when it is generated again, and that is marked by
+ * the "processed" attribute. The kept models are held in a bounded heap, so a level
+ * costs O(n log width) rather than a full sort. State-based models can be equivalent
+ * without being the same object; they are ranked in full, and a model equivalent to
+ * one already kept is skipped. With eviction on, new models which are not kept are
+ * deleted from the model cache.
+ *
+ * A long search can be checkpointed after each level, and resumed from that level
+ * later. The checkpoint is a binary file holding the report's models (by name, with
+ * their attributes, IDs and progenitors) and which of them were kept at the level.
+ * It starts with a fingerprint of the data and the search settings (search type,
+ * direction, sort attribute and width), and is only resumed by a search with the
+ * same fingerprint. It is written to a temporary file and renamed, so a job killed
+ * while writing leaves the previous checkpoint intact.
+ */
+class SearchDriver {
+    public:
+        SearchDriver(VBMManager *mgr);
+        SearchDriver(SBMManager *mgr);
+        ~SearchDriver();
+
+        void setWidth(int w) {
+            width = w > 0 ? w : 1;
+        }
+        void setSortAttr(const char *name);
+        void setSortDirection(Direction dir) {
+            sortDirection = dir;
+        }
+        // delete the new models which are not kept from the model cache
+        void setEvict(bool flag) {
+            evict = flag;
+        }
+        // when a model is generated again by another progenitor, keep the
+        // progenitor giving the best incremental alpha
+        void setIncrementalAlpha(bool flag) {
+            incrementalAlpha = flag;
+        }
+
+        // Process one level: search from each of the old models, and return the best
+        // of the new models, best first, as a null-terminated array (to be deleted by
+        // the caller). Each new model gets the given level and its progenitor.
+        Model **processLevel(int level, Model **oldModels, long oldCount);
+
+        // the number of new models generated, and kept, by the last processLevel
+        long getGeneratedCount() {
+            return generatedCount;
+        }
+        // the number of models the last processLevel's searches returned, including
+        // those already made by another progenitor or an earlier level
+        long getSearchedCount() {
+            return searchedCount;
+        }
+        long getKeptCount() {
+            return keptCount;
+        }
+
+        // Write the state of the search after the given level: the models in the
+        // report and the models kept at the level. Returns false if the file can't
+        // be written.
+        bool writeCheckpoint(const char *path, int level, Model **kept, long keptCount, Report *report);
+
+        // Read a checkpoint, adding its models to the (empty) report. Returns the kept
+        // models as processLevel does (with getKeptCount() set), and the level and the
+        // highest model ID through the pointers; or NULL if there is no checkpoint, or
+        // (with a warning) if it can't be read or is from a different search.
+        Model **readCheckpoint(const char *path, int *level, int *lastID, Report *report);
+
+        // true if model a ranks ahead of model b on the sort attribute
+        bool isBetter(Model *a, Model *b);
+
+    private:
+        SearchBase *getSearch();
+        std::string getFingerprint();
+        bool needsFit();
+        void computeSortStatistic(Model *model);
+        void addCandidate(Model *model);
+
+        ManagerBase *manager;
+        VBMManager *vbManager;
+        SBMManager *sbManager;
+        int width;
+        char *sortAttr;
+        Direction sortDirection;
+        bool evict;
+        bool incrementalAlpha;
+        std::vector<Model*> heap; // the best candidates so far, worst at the top (all
+                                  // candidates, unordered, for state-based models)
+        long generatedCount;
+        long searchedCount;
+        long keptCount;
+};
+
+#endif
@@ -17,14 +17,17 @@
 /*
  * Table - defines a data table, which is a collection of tuples. The tuples are stored
  * in a contiguous table.  Since tuples are variable sized, the Table object stores the
- * size information for the tuple storage.
+ * size information for the tuple storage. Interleaved tables keep each tuple's key and
+ * value together; columnar tables keep all the keys in one block and the values in a
+ * separate array, which is faster for loops that only touch the values.
  */
 
 class Relation;
 
 class Table {
     public:
-        Table(int keysz, long long maxTuples, TableType typ = TableType:: InformationTheoretic); // initialize the table and allocate tuple space
+        Table(int keysz, long long maxTuples, TableType typ = TableType:: InformationTheoretic,
+              TableLayout lay = TableLayout::Interleaved); // initialize the table and allocate tuple space
         ~Table();
         long long size();
 
@@ -36,6 +39,16 @@ class Table {
         void insertTuple(KeySegment *key, double value, long long index); // insert in given spot
         void sumTuple(KeySegment *key, double value); // add (or) this value to matching tuple
 
+        //-- hash accumulation mode. While active, sumTuple finds matching tuples through an
+        //-- open-addressed hash of the keys and appends new tuples unsorted, rather than
+        //-- inserting each one in place. indexOf is not valid until finalize() is called,
+        //-- which sorts the tuples once and releases the hash.
+        void beginHashAccumulation(long long expectedTuples = 0);
+        void finalize();
+        bool isAccumulating() {
+            return hashSlots != NULL;
+        }
+
         //-- key and value access functions
         double getValue(long long index);
         void setValue(long long index, double value);
@@ -45,15 +58,46 @@ class Table {
         //-- find the given key. If matchOnly is true, -1 is returned on no match.
         //-- if matchOnly is false, the position of the next higher tuple is returned
         long long indexOf(KeySegment *key, bool matchOnly = true); //
+
+        //-- dense index. For a sorted table over a small state space (such as the projection
+        //-- for a low-order relation), a direct-addressed array can map every cell of the state
+        //-- space of the given variables to its tuple, so that indexOf(key) is an array read
+        //-- instead of a binary search. Any change to the table's tuples discards the index.
+        void buildDenseIndex(class VariableList *vars, int *varIndices, int varCount);
+        void releaseDenseIndex();
+        bool hasDenseIndex() {
+            return denseIndex != NULL;
+        }
         long long getTupleCount() {
             return tupleCount;
         }
         int getKeySize() {
             return keysize;
         }
+        TableLayout getLayout() {
+            return layout;
+        }
+
+        //-- direct access to the keys: key i is at getKeyArray() + i * getKeyStride().
+        KeySegment *getKeyArray() {
+            return (KeySegment*) data;
+        }
+        long long getKeyStride() {
+            return keyStride;
+        }
+
+        //-- direct access to the values: value i is at getValueArray()[i * getValueStride()].
+        //-- The stride is 1 for columnar tables.
+        ocTupleValue *getValueArray() {
+            return values;
+        }
+        long long getValueStride() {
+            return valueStride;
+        }
 
         void sort(); // sort tuples by key
         void reset(int keysize); // reset table to empty, but reuse the storage
+        void reserve(long long tuples); // make room for this many tuples, without zero-filling
 
         // dump debug output
         void dump(bool detail = false);
@@ -71,11 +115,41 @@ class Table {
         double getLowestValue();
 
     private:
-        void* data; // storage for all keys and values
+        void* data; // storage for all keys, and for interleaved tables, the values too
+        ocTupleValue *values; // first value; a separate array only for columnar tables
+        TableLayout layout; // Interleaved or Columnar
+        long long keyStride; // KeySegments from one key to the next
+        long long valueStride; // ocTupleValues from one value to the next
         int keysize; // number of key segments in the key for each tuple
         long long tupleCount; // number of tuples in the tuple array
         long long maxTupleCount; // the total size of the data member, in terms of tuples
         TableType type; // one of INFO_TYPE, SET_TYPE
+        struct DenseDigit { // position and place value of one variable in the dense cell number
+            int segment;
+            int shift;
+            KeySegment mask;
+            int cardinality;
+            long long stride;
+        };
+        DenseDigit *denseDigits; // one per variable of the dense index
+        int denseDigitCount;
+        int *denseIndex; // tuple index for each cell (-1 if empty); NULL if no dense index
+        long long *hashSlots; // tuple index for each hash slot (-1 if empty); NULL unless accumulating
+        long long hashSlotCount; // number of hash slots, always a power of 2
+
+        void rehash(long long slotCount);
+        void releaseHash();
+
+        KeySegment *keyAt(long long index) const {
+            return (KeySegment*) data + keyStride * index;
+        }
+        ocTupleValue *valueAt(long long index) const {
+            return values + valueStride * index;
+        }
+        void setLayoutPointers();
+        void grow();
+        void insertionSort();
+        void radixSort();
 };
 
 template <typename F>
@@ -85,12 +159,7 @@ void tableIteration(Table* input_table, VariableList* varlist, Relation* rel,
     long long dataCount = input_table->getTupleCount();
     int *key_order = new int[dataCount];
     for (long long i = 0; i < dataCount; i++) { key_order[i] = i; }
-    sort_var_list = varlist;
-    sort_count = var_count;
-    sort_vars = nullptr;
-    sort_keys = nullptr;
-    sort_table = input_table;
-    qsort(key_order, dataCount, sizeof(int), sortKeys);
+    sortKeyOrder(key_order, dataCount, varlist, var_count, nullptr, nullptr, input_table);
     if (fit_table == NULL) { fit_table = input_table; }
     if (indep_table == NULL) { indep_table = fit_table; }
 
@@ -121,12 +190,7 @@ void tableKVIteration(Table* table, VariableList* varlist, long var_count, F act
     char* keystr = new char[var_count * MAXABBREVLEN + 1];
     int *key_order = new int[dataCount];
     for (long long i = 0; i < dataCount; i++) { key_order[i] = i; }
-    sort_var_list = varlist;
-    sort_count = var_count;
-    sort_vars = nullptr;
-    sort_keys = nullptr;
-    sort_table = table;
-    qsort(key_order, dataCount, sizeof(int), sortKeys);
+    sortKeyOrder(key_order, dataCount, varlist, var_count, nullptr, nullptr, table);
     for (long long order_i = 0; order_i < dataCount; order_i++) {
         int i = key_order[order_i];
         KeySegment* key = table->getKey(i);
@@ -17,5 +17,6 @@ typedef unsigned long KeySegment;
 typedef double ocTupleValue;
 enum class Direction { Ascending, Descending };
 enum class TableType { InformationTheoretic, SetTheoretic };
+enum class TableLayout { Interleaved, Columnar };
 
 #endif
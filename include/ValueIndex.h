@@ -0,0 +1,68 @@
+/*
+ * Copyright © 1990 The Portland State University OCCAM Project Team
+ * [This program is licensed under the GPL version 3 or later.]
+ * Please see the file LICENSE in the source
+ * distribution of this software for license terms.
+ */
+
+#ifndef ___ValueIndex
+#define ___ValueIndex
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * ValueIndex - maps the values of a nominal variable, as they appear in the data, to
+ * their index in the variable's value map. Values which are plain non-negative
+ * integers (no sign or leading zeros, as most coded data is) are looked up directly
+ * in an array; others are hashed. Lookups don't change the index, so any number of
+ * threads can look up values at once, as long as none is adding them.
+ */
+#define VALUE_INDEX_MAX_DIRECT (1 << 20)
+
+class ValueIndex {
+    public:
+        // the index of the value given by the first length characters of value,
+        // or -1 if it hasn't been added
+        int find(const char *value, int length) const {
+            int number = directNumber(value, length);
+            if (number >= 0)
+                return number < (int) direct.size() ? direct[number] : -1;
+            std::unordered_map<std::string, int>::const_iterator found = others.find(std::string(value, length));
+            return found == others.end() ? -1 : found->second;
+        }
+
+        // add a value, if it isn't there already
+        void add(const char *value, int length, int index) {
+            int number = directNumber(value, length);
+            if (number >= 0) {
+                if (number >= (int) direct.size())
+                    direct.resize(number + 1, -1);
+                if (direct[number] < 0)
+                    direct[number] = index;
+            } else {
+                others.insert(std::make_pair(std::string(value, length), index));
+            }
+        }
+
+    private:
+        // the value as a number, if it is a plain integer small enough to index
+        // directly; otherwise -1
+        static int directNumber(const char *value, int length) {
+            if (length == 0 || length > 7 || (value[0] == '0' && length > 1))
+                return -1;
+            int number = 0;
+            for (int i = 0; i < length; i++) {
+                if (value[i] < '0' || value[i] > '9')
+                    return -1;
+                number = number * 10 + (value[i] - '0');
+            }
+            return number < VALUE_INDEX_MAX_DIRECT ? number : -1;
+        }
+
+        std::vector<int> direct; // index of each integer value, or -1
+        std::unordered_map<std::string, int> others;
+};
+
+#endif
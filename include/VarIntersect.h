@@ -9,6 +9,7 @@
 #define ___VarIntersect
 
 #include "Relation.h"
+#include <string.h>
 
 struct VarIntersect {
         int startIndex; // the highest numbered relation index this intersection term represents
@@ -20,4 +21,112 @@ struct VarIntersect {
         }
 };
 
+/**
+ * VarIntersectLevel - one level of intersection terms, as built by
+ * ManagerBase::doIntersectionProcessing. Terms are hashed on relation and start index,
+ * so a repeated term just adds to the count of the first. The storage only grows, and
+ * is kept for reuse by the next level or model; clear() empties the level.
+ */
+class VarIntersectLevel {
+    public:
+        VarIntersectLevel() :
+                terms(NULL), termSlots(NULL), termCount(0), termMax(0), slots(NULL), slotCount(0) {
+        }
+
+        ~VarIntersectLevel() {
+            if (terms)
+                delete[] terms;
+            if (termSlots)
+                delete[] termSlots;
+            if (slots)
+                delete[] slots;
+        }
+
+        int size() {
+            return termCount;
+        }
+
+        VarIntersect &operator[](int i) {
+            return terms[i];
+        }
+
+        void clear() {
+            for (int i = 0; i < termCount; i++) {
+                slots[termSlots[i]] = 0;
+            }
+            termCount = 0;
+        }
+
+        // add count to the term (rel, startIndex), making the term if it is new
+        void add(Relation *rel, int startIndex, bool sign, int count) {
+            //-- keep the table at most half full
+            if (2 * (termCount + 1) > slotCount)
+                rehash(slotCount ? 2 * slotCount : 64);
+            int last = slotCount - 1;
+            int slot = hash(rel, startIndex) & last;
+            for (; slots[slot]; slot = (slot + 1) & last) {
+                VarIntersect &term = terms[slots[slot] - 1];
+                if (term.rel == rel && term.startIndex == startIndex) {
+                    term.count += count;
+                    return;
+                }
+            }
+            if (termCount >= termMax)
+                grow();
+            VarIntersect &term = terms[termCount];
+            term.rel = rel;
+            term.startIndex = startIndex;
+            term.sign = sign;
+            term.count = count;
+            termSlots[termCount] = slot;
+            slots[slot] = ++termCount;
+        }
+
+    private:
+        void grow() {
+            int newMax = termMax ? 2 * termMax : 64;
+            VarIntersect *newTerms = new VarIntersect[newMax];
+            int *newSlots = new int[newMax];
+            if (termCount > 0) {
+                memcpy(newTerms, terms, termCount * sizeof(VarIntersect));
+                memcpy(newSlots, termSlots, termCount * sizeof(int));
+            }
+            if (terms)
+                delete[] terms;
+            if (termSlots)
+                delete[] termSlots;
+            terms = newTerms;
+            termSlots = newSlots;
+            termMax = newMax;
+        }
+
+        static unsigned long hash(Relation *rel, int startIndex) {
+            unsigned long long h = (unsigned long long) rel * 0x9E3779B97F4A7C15ULL + startIndex;
+            return (unsigned long) (h ^ (h >> 29));
+        }
+
+        void rehash(int newCount) {
+            if (slots)
+                delete[] slots;
+            slotCount = newCount;
+            slots = new int[slotCount];
+            memset(slots, 0, slotCount * sizeof(int));
+            int last = slotCount - 1;
+            for (int i = 0; i < termCount; i++) {
+                int slot = hash(terms[i].rel, terms[i].startIndex) & last;
+                while (slots[slot])
+                    slot = (slot + 1) & last;
+                slots[slot] = i + 1;
+                termSlots[i] = slot;
+            }
+        }
+
+        VarIntersect *terms;
+        int *termSlots; // the slot holding each term
+        int termCount;
+        int termMax;
+        int *slots; // 1 + the index of the term in each slot, or 0 if empty
+        int slotCount;
+};
+
 #endif
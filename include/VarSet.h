@@ -0,0 +1,170 @@
+/*
+ * Copyright © 1990 The Portland State University OCCAM Project Team
+ * [This program is licensed under the GPL version 3 or later.]
+ * Please see the file LICENSE in the source
+ * distribution of this software for license terms.
+ */
+
+#ifndef ___VarSet
+#define ___VarSet
+
+#include <string.h>
+
+/**
+ * VarSet - a set of variable indices, one bit per variable. Relations keep one
+ * alongside their sorted variable list, so that containment, intersection and
+ * complement are word-wide AND/OR operations rather than list walks.
+ * Sets of up to VARSET_INLINE_WORDS * 64 variables (256) are held in the object
+ * itself; larger ones are allocated. Single-word sets (up to 64 variables, the
+ * usual case) take a shortcut in each operation.
+ * Sets to be combined should be sized for the same variable list.
+ */
+#define VARSET_WORD_BITS 64
+#define VARSET_INLINE_WORDS 4
+
+class VarSet {
+    public:
+        // an empty set, with room for variables 0 .. varCount-1
+        VarSet(int varCount = 0) {
+            wordCount = varCount > 0 ? (varCount + VARSET_WORD_BITS - 1) / VARSET_WORD_BITS : 1;
+            words = wordCount <= VARSET_INLINE_WORDS ? inlineWords : new unsigned long long[wordCount];
+            memset(words, 0, wordCount * sizeof(unsigned long long));
+        }
+
+        VarSet(const VarSet &other) {
+            wordCount = other.wordCount;
+            words = wordCount <= VARSET_INLINE_WORDS ? inlineWords : new unsigned long long[wordCount];
+            memcpy(words, other.words, wordCount * sizeof(unsigned long long));
+        }
+
+        VarSet &operator=(const VarSet &other) {
+            if (this != &other) {
+                if (words != inlineWords)
+                    delete[] words;
+                wordCount = other.wordCount;
+                words = wordCount <= VARSET_INLINE_WORDS ? inlineWords : new unsigned long long[wordCount];
+                memcpy(words, other.words, wordCount * sizeof(unsigned long long));
+            }
+            return *this;
+        }
+
+        ~VarSet() {
+            if (words != inlineWords)
+                delete[] words;
+        }
+
+        long size() {
+            return sizeof(VarSet) + (words != inlineWords ? wordCount * sizeof(unsigned long long) : 0);
+        }
+
+        void add(int var) {
+            words[var / VARSET_WORD_BITS] |= 1ULL << (var % VARSET_WORD_BITS);
+        }
+
+        void remove(int var) {
+            words[var / VARSET_WORD_BITS] &= ~(1ULL << (var % VARSET_WORD_BITS));
+        }
+
+        bool has(int var) const {
+            int w = var / VARSET_WORD_BITS;
+            return w < wordCount && (words[w] >> (var % VARSET_WORD_BITS) & 1);
+        }
+
+        // true if every variable of other is in this set
+        bool contains(const VarSet &other) const {
+            if (wordCount == 1 && other.wordCount == 1)
+                return (other.words[0] & ~words[0]) == 0;
+            for (int w = 0; w < other.wordCount; w++) {
+                unsigned long long mine = w < wordCount ? words[w] : 0;
+                if (other.words[w] & ~mine)
+                    return false;
+            }
+            return true;
+        }
+
+        // true if the sets have a variable in common
+        bool intersects(const VarSet &other) const {
+            if (wordCount == 1 && other.wordCount == 1)
+                return (other.words[0] & words[0]) != 0;
+            int n = wordCount < other.wordCount ? wordCount : other.wordCount;
+            for (int w = 0; w < n; w++) {
+                if (other.words[w] & words[w])
+                    return true;
+            }
+            return false;
+        }
+
+        bool equals(const VarSet &other) const {
+            return contains(other) && other.contains(*this);
+        }
+
+        // this = this AND other
+        void intersectWith(const VarSet &other) {
+            for (int w = 0; w < wordCount; w++) {
+                words[w] &= w < other.wordCount ? other.words[w] : 0;
+            }
+        }
+
+        // this = this OR other
+        void unionWith(const VarSet &other) {
+            int n = wordCount < other.wordCount ? wordCount : other.wordCount;
+            for (int w = 0; w < n; w++) {
+                words[w] |= other.words[w];
+            }
+        }
+
+        // this = this AND NOT other
+        void subtract(const VarSet &other) {
+            int n = wordCount < other.wordCount ? wordCount : other.wordCount;
+            for (int w = 0; w < n; w++) {
+                words[w] &= ~other.words[w];
+            }
+        }
+
+        bool isEmpty() const {
+            for (int w = 0; w < wordCount; w++) {
+                if (words[w])
+                    return false;
+            }
+            return true;
+        }
+
+        int count() const {
+            int n = 0;
+            for (int w = 0; w < wordCount; w++) {
+                n += __builtin_popcountll(words[w]);
+            }
+            return n;
+        }
+
+        // the smallest variable in the set which is >= var, or -1 if there is none
+        int next(int var = 0) const {
+            int w = var / VARSET_WORD_BITS;
+            if (w >= wordCount)
+                return -1;
+            unsigned long long bits = words[w] & (~0ULL << (var % VARSET_WORD_BITS));
+            for (;;) {
+                if (bits)
+                    return w * VARSET_WORD_BITS + __builtin_ctzll(bits);
+                if (++w >= wordCount)
+                    return -1;
+                bits = words[w];
+            }
+        }
+
+        // copy the variables, in increasing order, to vars. Returns the number copied.
+        int copyVariables(int *vars, int maxCount) const {
+            int n = 0;
+            for (int var = next(0); var >= 0 && n < maxCount; var = next(var + 1)) {
+                vars[n++] = var;
+            }
+            return n;
+        }
+
+    private:
+        int wordCount;
+        unsigned long long *words;
+        unsigned long long inlineWords[VARSET_INLINE_WORDS];
+};
+
+#endif
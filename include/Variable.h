@@ -22,9 +22,13 @@ class Variable { // internal use only - see VariableList
         char name[MAXNAMELEN + 1]; // long name of variable (max 32 chars)
         char abbrev[MAXABBREVLEN + 1]; // abbreviated name for variable
         char* valmap[MAXCARDINALITY]; // maps input file values to nominal values
+        int valueCount; // number of values in valmap
+        class ValueIndex *valueIndex; // index of each value in valmap
         bool rebin; //is rebinning required for this variable
         char * oldnew[2][MAXCARDINALITY];
         int old_card;
+        class ValueIndex *rebinIndex; // first oldnew entry for each old value
+        int rebinWildcard; // first "*" entry in oldnew, or -1
         char *exclude;
 };
 
@@ -87,6 +87,9 @@ class VariableList {
         //get the new rebinning value for an old one
         int getNewValue(int, char*, char*);
 
+        //-- index the old values of a variable's rebinning map, once it is complete
+        void indexRebinning(int index);
+
     private:
         Variable *vars;
         int varCount; // number of variables defined so far
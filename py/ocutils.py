@@ -5,7 +5,7 @@
 # distribution of this software for license terms.
 
 # coding=utf8
-import sys, re, occam, time, heapq, ocGraph
+import os, sys, re, occam, time, ocGraph
 
 totalgen=0
 totalkept=0
@@ -55,6 +55,8 @@ class ocUtils:
         self.__PercentCorrect = 0
         self.__IncrementalAlpha = 0
         self.__NoIPF = 0
+        self.__checkpointFile = ""
+        self.__dataCacheFile = ""
         
         self.graphs = {}
         self.__graphWidth = 500
@@ -77,6 +79,8 @@ class ocUtils:
 
     #-- Read command line args and process input file
     def initFromCommandLine(self, argv):
+        if self.__dataCacheFile != "":
+            argv = argv[0:1] + ["--data-cache-file=" + self.__dataCacheFile] + argv[1:]
         self.__manager.initFromCommandLine(argv)
         self.occam2Settings()
 
@@ -182,6 +186,17 @@ class ocUtils:
     def getStartModel(self):
         return self.__startModel
 
+    # Save the search state to this file after each level, and resume from it
+    # if it exists when the search starts and is from the same data and search
+    # settings. It is removed once the search finishes. ("" for no checkpoints)
+    def setCheckpointFile(self, checkpointFile):
+        self.__checkpointFile = checkpointFile
+
+    # Save the data, once read, as a binary data cache which can be given in place of
+    # the data file, to load faster. ("" for none; set before initFromCommandLine)
+    def setDataCacheFile(self, dataCacheFile):
+        self.__dataCacheFile = dataCacheFile
+
     def setFitModel(self, fitModel):
         self.__fitModels = [fitModel]
 
@@ -241,53 +256,13 @@ class ocUtils:
             self.__manager.computeL2Statistics(model)
             self.__manager.computeDependentStatistics(model)
  
-    # this function generates the parents/children of the given model, and for
-    # any which haven't been seen before puts them into the newModel list
-    # this function also computes the LR statistics (H, LR, DF, etc.) as well
-    # as the dependent statistics (dH, %dH, etc.)
-    def processModel(self, level, newModelsHeap, model):
-        addCount = 0
-        generatedModels = self.__manager.searchOneLevel(model)
-        for newModel in generatedModels:
-            if newModel.get("processed") <= 0.0 :
-                newModel.processed = 1.0
-                newModel.level = level
-                newModel.setProgenitor(model)
-                self.computeSortStatistic(newModel)
-    # need a fix here (or somewhere) to check for (and remove) models that have the same DF as the progenitor
-                # decorate model with a key for sorting, & push onto heap
-                key = newModel.get(self.sortName)
-                if self.__searchSortDir == "descending":
-                    key = -key
-                heapq.heappush(newModelsHeap, ([key, newModel.get("name")] , newModel))     # appending the model name makes sort alphabet-consistent
-                addCount += 1
-            else:
-                if self.__IncrementalAlpha:
-                    # this model has been made already, but this progenitor might lead to a better Incr.Alpha
-                    # so we ask the manager to check on that, and save the best progenitor
-                    self.__manager.compareProgenitors(newModel, model)
-        return addCount
-
-            
     # This function processes models from one level, and return models for the next level.
+    # The manager generates the parents/children of each model, computes the sort
+    # statistic for any which haven't been seen before, and keeps the best of them
+    # (see SearchDriver); with clear_cache_flag set, the rest are dropped from the cache.
     def processLevel(self, level, oldModels, clear_cache_flag):
-        # start a new heap
-        newModelsHeap = []
-        fullCount = 0
-        for model in oldModels:
-            fullCount += self.processModel(level, newModelsHeap, model)
-        # if searchWidth < heapsize, pop off searchWidth and add to bestModels
-        bestModels = []
-        lastKey = ['','']
-        while len(newModelsHeap) > 0:
-            # make sure that we're adding unique models to the list (mostly for state-based)
-            key, candidate = heapq.heappop(newModelsHeap)
-            if (len(bestModels) < self.__searchWidth): # or key[0] == lastKey[0]:      # comparing keys allows us to select more than <width> models,
-                if True not in [n.isEquivalentTo(candidate) for n in bestModels]:   # in the case of ties
-                    bestModels.append(candidate)
-                    lastKey = key
-            else:
-                break
+        bestModels, fullCount = self.__manager.searchLevel(level, oldModels, self.__searchWidth, self.sortName,
+                self.__searchSortDir == "descending", clear_cache_flag, self.__IncrementalAlpha)
         truncCount = len(bestModels)
         self.totalgen  = fullCount + self.totalgen
         self.totalkept = truncCount + self.totalkept
@@ -295,9 +270,6 @@ class ocUtils:
         if not self.__hide_intermediate_output:
             print '%d new models, %ld kept; %ld total models, %ld total kept; %ld kb memory used; ' % (fullCount, truncCount, self.totalgen+1, self.totalkept+1, memUsed/1024),
         sys.stdout.flush()
-        if clear_cache_flag:
-            for item in newModelsHeap:
-                self.__manager.deleteModelFromCache(item[1])
         return bestModels
 
 
@@ -349,6 +321,34 @@ class ocUtils:
                 searchMode = "sb-full-down"
         return searchMode
 
+    # If there is a checkpoint file from an earlier run, restore the report and the
+    # models kept at the last finished level. Returns (models, next level), or None.
+    def __resumeCheckpoint(self):
+        if self.__checkpointFile == "" or not os.path.exists(self.__checkpointFile):
+            return None
+        # the manager prints a warning if the checkpoint is unreadable or from another search
+        state = self.__manager.readCheckpoint(self.__checkpointFile, self.__report, self.__searchWidth,
+                self.sortName, self.__searchSortDir == "descending")
+        if state is None:
+            return None
+        level, models, self.__nextID = state
+        print "Resuming search from level %d checkpoint" % level
+        # a chain search only does one level; a search which ran out of models is done
+        if self.__searchFilter == "chain" or len(models) == 0:
+            level = self.__searchLevels
+        return models, level + 1
+
+    def __writeCheckpoint(self, level, models):
+        if self.__checkpointFile != "":
+            if not self.__manager.writeCheckpoint(self.__checkpointFile, level, models, self.__report,
+                    self.__searchWidth, self.sortName, self.__searchSortDir == "descending"):
+                print "WARNING: unable to write checkpoint " + self.__checkpointFile
+
+    # once the search is finished, its checkpoint mustn't be resumed
+    def __removeCheckpoint(self):
+        if self.__checkpointFile != "" and os.path.exists(self.__checkpointFile):
+            os.remove(self.__checkpointFile)
+
     def doSearch(self, printOptions):
         if self.__manager.isDirected():
             if self.searchDir == "down":
@@ -403,26 +403,34 @@ class ocUtils:
             self.__manager.computePercentCorrect(start)
         if self.__IncrementalAlpha:
             self.__manager.computeIncrementalAlpha(start)
-        start.level = 0
-        self.__report.addModel(start)
-        self.__nextID = 1
-        start.setID(self.__nextID)
-        start.setProgenitor(start)
-        oldModels = [start]
         try:
             self.__manager.setSearchType(self.searchType())
         except:
             print "ERROR: UNDEFINED SEARCH TYPE " + self.searchType()
             return
+        # the checkpoint records the search type, so set it before resuming
+        resumed = self.__resumeCheckpoint()
+        if resumed:
+            oldModels, firstLevel = resumed
+        else:
+            start.level = 0
+            self.__report.addModel(start)
+            self.__nextID = 1
+            start.setID(self.__nextID)
+            start.setProgenitor(start)
+            oldModels = [start]
+            firstLevel = 1
         # process each level, up to the number of levels indicated. Each of the best models
         # is added to the report generator for later output
         if self.__HTMLFormat: print '<pre>'
         print "Searching levels:"
         start_time = time.time()
         last_time = start_time
-        for i in xrange(1,self.__searchLevels+1):
+        finished = True
+        for i in xrange(firstLevel,self.__searchLevels+1):
             if self.__manager.getMemUsage() > maxMemoryToUse:
                 print "Memory limit exceeded: stopping search"
+                finished = False
                 break
             print i,':',    # progress indicator
             newModels = self.processLevel(i, oldModels, i != self.__searchLevels)
@@ -445,10 +453,13 @@ class ocUtils:
                 model.setID(self.__nextID)
                 #model.deleteFitTable()  #recover fit table memory
                 self.__report.addModel(model)
+            self.__writeCheckpoint(i, newModels)
             oldModels = newModels
             # if the list is empty, stop. Also, only do one step for chain search
             if self.__searchFilter == "chain" or len(oldModels) == 0:
                 break
+        if finished:
+            self.__removeCheckpoint()
         if self.__HTMLFormat: print '</pre><br>'
         else: print ""
 
@@ -482,24 +493,32 @@ class ocUtils:
             self.__manager.computePercentCorrect(start)
         if self.__IncrementalAlpha:
             self.__manager.computeIncrementalAlpha(start)
-        start.level = 0
-        self.__report.addModel(start)
-        self.__nextID = 1
-        start.setID(self.__nextID)
-        start.setProgenitor(start)
-        oldModels = [start]
         try:
             self.__manager.setSearchType(self.sbSearchType())
         except:
             print "ERROR: UNDEFINED SEARCH TYPE " + self.sbSearchType()
             return
+        # the checkpoint records the search type, so set it before resuming
+        resumed = self.__resumeCheckpoint()
+        if resumed:
+            oldModels, firstLevel = resumed
+        else:
+            start.level = 0
+            self.__report.addModel(start)
+            self.__nextID = 1
+            start.setID(self.__nextID)
+            start.setProgenitor(start)
+            oldModels = [start]
+            firstLevel = 1
         if self.__HTMLFormat: print '<pre>'
         print "Searching levels:"
         start_time = time.time()
         last_time = start_time
-        for i in xrange(1,self.__searchLevels+1):
+        finished = True
+        for i in xrange(firstLevel,self.__searchLevels+1):
             if self.__manager.getMemUsage() > maxMemoryToUse:
                 print "Memory limit exceeded: stopping search"
+                finished = False
                 break
             print i,':',    # progress indicator
             newModels = self.processLevel(i, oldModels, i != self.__searchLevels)
@@ -521,10 +540,13 @@ class ocUtils:
                 model.setID(self.__nextID)
                 model.deleteFitTable()  #recover fit table memory
                 self.__report.addModel(model)
+            self.__writeCheckpoint(i, newModels)
             oldModels = newModels
             # if the list is empty, stop. Also, only do one step for chain search
             if self.__searchFilter == "chain" or len(oldModels) == 0:
                 break
+        if finished:
+            self.__removeCheckpoint()
         if self.__HTMLFormat: print '</pre><br>'
         else: print ""
 
@@ -805,6 +827,9 @@ class ocUtils:
         option = self.__manager.getOption("reference-model")
         if option != "":
             self.__refModel = option
+        option = self.__manager.getOption("checkpoint-file")
+        if option != "":
+            self.__checkpointFile = option
         option = self.__manager.getOption("search-direction")
         if option != "":
             self.searchDir = option